@@ -2,6 +2,9 @@ QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+# Banded polygon fill runs on the global thread pool
+QT += concurrent
+
 CONFIG += c++17
 
 # You can make your code fail to compile if it uses deprecated APIs.
@@ -17,7 +20,25 @@ SOURCES += \
     circle.cpp \
     polygon.cpp \
     rectangle.cpp \
-    clipping.cpp
+    clipping.cpp \
+    framebuffer.cpp \
+    strokemask.cpp \
+    capsule.cpp \
+    stroke.cpp \
+    linebatch.cpp \
+    coveragemask.cpp \
+    scanlinefill.cpp \
+    scaledtexture.cpp \
+    edgegrid.cpp \
+    segmentbuffer.cpp \
+    vertexgrid.cpp \
+    coveragefill.cpp \
+    fillshader.cpp \
+    shapesprite.cpp \
+    tilerenderer.cpp \
+    renderthread.cpp \
+    spatialgrid.cpp \
+    pickbuffer.cpp
 
 HEADERS += \
     mainwindow.h \
@@ -27,7 +48,26 @@ HEADERS += \
     circle.h \
     polygon.h \
     rectangle.h \
-    clipping.h
+    clipping.h \
+    framebuffer.h \
+    strokemask.h \
+    capsule.h \
+    coveragefill.h \
+    coveragemask.h \
+    fillshader.h \
+    linebatch.h \
+    linekernel.h \
+    scaledtexture.h \
+    edgegrid.h \
+    segmentbuffer.h \
+    vertexgrid.h \
+    scanlinefill.h \
+    shapesprite.h \
+    tilerenderer.h \
+    renderthread.h \
+    spatialgrid.h \
+    pickbuffer.h \
+    stroke.h
 
 FORMS += \
     mainwindow.ui
@@ -1,50 +1,89 @@
 #include "brush.h"
-#include <cmath>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
-Brush::Brush(int size)
-    : m_size(size)
+namespace {
+
+// Row y of a size x size disc. Sizes 1 and 2 fill the whole square; larger
+// sizes keep the cells whose center lies within (size - 1) / 2 of the brush
+// center, tested exactly in doubled integer coordinates. The disc is convex,
+// so each row is a single run.
+constexpr Brush::Span discRow(int size, int y)
 {
-    generateCircularPattern();
+    if (size <= 2) return Brush::Span{0, size};
+
+    const long long diameter = size - 1;
+    const long long dy = 2LL * y - diameter;
+    int first = -1;
+    int last = -1;
+    for (int x = 0; x < size; ++x) {
+        const long long dx = 2LL * x - diameter;
+        if (dx * dx + dy * dy <= diameter * diameter) {
+            if (first < 0) first = x;
+            last = x;
+        }
+    }
+    return first < 0 ? Brush::Span{0, 0} : Brush::Span{first, last - first + 1};
 }
 
-void Brush::generateCircularPattern()
+using SpanTable = std::array<Brush::Span, Brush::MaxTableSize>;
+
+constexpr std::array<SpanTable, Brush::MaxTableSize> makeTables()
 {
-    // Initialize pattern with false values
-    m_pattern.resize(m_size, std::vector<bool>(m_size, false));
-    
-    // For size 1, just set the single point
-    if (m_size == 1) {
-        m_pattern[0][0] = true;
-        return;
+    std::array<SpanTable, Brush::MaxTableSize> tables{};
+    for (int size = 1; size <= Brush::MaxTableSize; ++size) {
+        for (int y = 0; y < size; ++y) {
+            tables[size - 1][y] = discRow(size, y);
+        }
     }
-    
-    // For size 2, create a 2x2 square
-    if (m_size == 2) {
-        m_pattern[0][0] = true;
-        m_pattern[0][1] = true;
-        m_pattern[1][0] = true;
-        m_pattern[1][1] = true;
-        return;
+    return tables;
+}
+
+constexpr std::array<SpanTable, Brush::MaxTableSize> kTables = makeTables();
+
+} // namespace
+
+Brush::Brush(int size, const Span* spans)
+    : m_size(size), m_spans(spans)
+{
+}
+
+Brush::Brush(int size)
+    : m_size(size)
+{
+    m_storage.resize(size);
+    for (int y = 0; y < size; ++y) {
+        m_storage[y] = discRow(size, y);
     }
-    
-    // For larger sizes, generate a proper circle
-    float center = (m_size - 1) / 2.0f;
-    float radius = center;
-    
-    // Generate circular pattern
-    for (int y = 0; y < m_size; ++y) {
-        for (int x = 0; x < m_size; ++x) {
-            // Calculate distance from center
-            float dx = x - center;
-            float dy = y - center;
-            float distance = std::sqrt(dx * dx + dy * dy);
-            
-            // If distance is less than or equal to radius, mark as part of pattern
-            if (distance <= radius) {
-                m_pattern[y][x] = true;
+    m_spans = m_storage.data();
+}
+
+const Brush& Brush::forSize(int size)
+{
+    size = std::max(size, 1);
+    if (size <= MaxTableSize) {
+        // Thin wrappers around the compile-time tables, created once
+        static const auto table = [] {
+            std::array<std::unique_ptr<Brush>, MaxTableSize> brushes;
+            for (int i = 0; i < MaxTableSize; ++i) {
+                brushes[i].reset(new Brush(i + 1, kTables[i].data()));
             }
-        }
+            return brushes;
+        }();
+        return *table[size - 1];
+    }
+
+    static std::mutex mutex;
+    static std::unordered_map<int, std::unique_ptr<Brush>> cache;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<Brush>& brush = cache[size];
+    if (!brush) {
+        brush.reset(new Brush(size));
     }
+    return *brush;
 }
 
 bool Brush::isInPattern(int x, int y) const
@@ -54,30 +93,20 @@ bool Brush::isInPattern(int x, int y) const
         return false;
     }
     
-    return m_pattern[y][x];
+    const Span& span = m_spans[y];
+    return x >= span.start && x < span.start + span.length;
 }
 
-float Brush::getIntensity(int x, int y) const
+void Brush::stamp(Framebuffer& fb, int x, int y, QRgb color) const
 {
-    if (!m_antiAliasing) {
-        return isInPattern(x, y) ? 1.0f : 0.0f;
-    }
-
-    // Check bounds
-    if (x < 0 || x >= m_size || y < 0 || y >= m_size) {
-        return 0.0f;
-    }
-
-    float center = (m_size - 1) / 2.0f;
-    float radius = center;
-    
-    // Calculate distance from center
-    float dx = x - center;
-    float dy = y - center;
-    float distance = std::sqrt(dx * dx + dy * dy);
+    int halfSize = m_size / 2;
+    int left = x - halfSize;
+    int top = y - halfSize;
     
-    // Calculate intensity based on distance from the edge
-    float intensity = 1.0f - std::min(1.0f, std::max(0.0f, (distance - (radius - 1.0f))));
-    
-    return intensity;
-}
\ No newline at end of file
+    for (int row = 0; row < m_size; ++row) {
+        const Span& span = m_spans[row];
+        if (span.length > 0) {
+            fb.fillSpan(left + span.start, left + span.start + span.length - 1, top + row, color);
+        }
+    }
+}
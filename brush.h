@@ -2,15 +2,31 @@
 #define BRUSH_H
 
 #include <vector>
-#include <cmath>
 #include <QColor>
+#include "framebuffer.h"
 
+// Immutable circular brush mask, interned by size.
+// Shapes hold a pointer obtained from Brush::forSize(); masks for sizes up to
+// MaxTableSize come from tables generated at compile time and larger ones are
+// built once on first use, so changing thickness never rebuilds a mask.
 class Brush {
 public:
-    Brush(int size);
+    // One horizontal run of the brush mask; a row with length 0 is empty
+    struct Span {
+        int start;  // first covered column, relative to the brush's left edge
+        int length; // number of covered columns
+    };
+
+    static constexpr int MaxTableSize = 32;
+
+    // Shared brush of the given size (sizes below 1 map to 1); thread-safe
+    static const Brush& forSize(int size);
+
+    Brush(const Brush&) = delete;
+    Brush& operator=(const Brush&) = delete;
     
-    // Get the brush pattern
-    const std::vector<std::vector<bool>>& getPattern() const { return m_pattern; }
+    // Get the per-row span table (one entry per row, size rows)
+    const Span* getSpans() const { return m_spans; }
     
     // Get the brush size
     int getSize() const { return m_size; }
@@ -18,17 +34,16 @@ public:
     // Check if a point is within the brush pattern
     bool isInPattern(int x, int y) const;
 
-    // Anti-aliasing support
-    void setAntiAliasing(bool enabled) { m_antiAliasing = enabled; }
-    bool isAntiAliasing() const { return m_antiAliasing; }
-    float getIntensity(int x, int y) const;
+    // Stamp the brush centered on (x, y), writing one span per row
+    void stamp(Framebuffer& fb, int x, int y, QRgb color) const;
 
 private:
-    void generateCircularPattern();
-    
+    Brush(int size, const Span* spans);
+    explicit Brush(int size);
+
     int m_size;
-    std::vector<std::vector<bool>> m_pattern;
-    bool m_antiAliasing = false;
+    const Span* m_spans;        // compile-time table or m_storage
+    std::vector<Span> m_storage; // only used above MaxTableSize
 };
 
-#endif // BRUSH_H
\ No newline at end of file
+#endif // BRUSH_H
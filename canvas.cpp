@@ -6,6 +6,7 @@
 #include "rectangle.h"
 #include "clipping.h"
 #include <algorithm>
+#include <limits>
 #include <QFileDialog>
 #include <QImage>
 
@@ -18,68 +19,267 @@ Canvas::Canvas(QWidget *parent)
     QPalette pal = palette();
     pal.setColor(QPalette::Window, Qt::white);
     setPalette(pal);
+
+    // Finished frames arrive from the render thread (queued to this one)
+    connect(&m_renderer, &RenderThread::frameReady, this, [this](const QRegion& region) { update(region); });
 }
 
 Canvas::~Canvas() = default;
 
-void Canvas::paintEvent(QPaintEvent *event)
+template <class Shape, class Edit>
+void Canvas::editShape(Shape* shape, Edit edit)
 {
-    Q_UNUSED(event);
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing, false);
-    
-    // Draw all lines
-    for (const auto& line : m_lines) {
-        line->draw(painter);
+    QRect before = shape->boundingRect();
+    edit();
+    indexOf(shape).update(shape);
+    if (!m_isBackgroundFrozen) {
+        // A dragged shape is left out of snapping, so it is re-listed once, on release
+        updateSnapTargets(shape);
     }
-    
-    // Draw all circles
-    for (const auto& circle : m_circles) {
-        circle->draw(painter);
+    markEdited(shape);
+    invalidate(before.united(shape->boundingRect()));
+}
+
+template <class Shape>
+void Canvas::markEdited(const Shape* shape)
+{
+    // Shapes not sent yet go out whole anyway, and the one being drawn is
+    // sent with every scene
+    if (m_sentVersions.find(shape) == m_sentVersions.end()) return;
+    Dirty<Shape>& dirty = dirtyOf(shape);
+    if (std::find(dirty.changed.begin(), dirty.changed.end(), shape) == dirty.changed.end()) {
+        dirty.changed.push_back(shape);
     }
-    
-    // Draw all polygons
-    for (const auto& polygon : m_polygons) {
-        polygon->draw(painter);
+}
+
+template <class Shape>
+void Canvas::markRemoved(const Shape* shape)
+{
+    Dirty<Shape>& dirty = dirtyOf(shape);
+    auto changed = std::find(dirty.changed.begin(), dirty.changed.end(), shape);
+    if (changed != dirty.changed.end()) {
+        dirty.changed.erase(changed);
     }
-    
-    // Draw all rectangles
-    for (const auto& rect : m_rectangles) {
-        rect->draw(painter);
+    if (m_sentVersions.erase(shape)) {
+        dirty.removed.push_back(shape);
     }
-    
-    // Draw current line if exists
-    if (m_currentLine) {
-        m_currentLine->draw(painter);
+}
+
+void Canvas::invalidate(const QRect& area)
+{
+    m_pickBuffer.invalidate(area);
+    m_isSceneChanged = true;
+    if (area.isNull()) {
+        // Shapes may have changed without editShape(): resend them all
+        m_isSceneReset = true;
+        update();
+    } else {
+        update(area);
     }
-    
-    // Draw current circle if exists
-    if (m_currentCircle) {
-        m_currentCircle->draw(painter);
+}
+
+PickBuffer::Hit Canvas::pick(const QPoint& point)
+{
+    // Redraw whatever changed since the last pick, then read one pixel
+    for (const QRect& area : m_pickBuffer.takeInvalid(size())) {
+        m_pickBuffer.begin(area);
+        for (Line* line : m_lineIndex.overlapping(area)) {
+            m_pickBuffer.add(line);
+        }
+        for (Circle* circle : m_circleIndex.overlapping(area)) {
+            m_pickBuffer.add(circle);
+        }
+        for (Polygon* polygon : m_polygonIndex.overlapping(area)) {
+            m_pickBuffer.add(polygon);
+        }
+        for (Rectangle* rect : m_rectangleIndex.overlapping(area)) {
+            m_pickBuffer.add(rect);
+        }
+        m_pickBuffer.render();
     }
-    
-    // Draw current polygon if exists
-    if (m_currentPolygon) {
-        m_currentPolygon->draw(painter);
+
+    // The buffer only holds visible parts, and a circle's interior only
+    // counts in fill mode; elsewhere the shape around point is hit
+    PickBuffer::Hit hit = m_pickBuffer.at(point);
+    if (hit.handle == PickBuffer::None || (hit.circle && hit.handle == PickBuffer::Interior && !m_isFillMode)) {
+        hit = enclosing(point);
     }
-    
-    // Draw current rectangle if exists
-    if (m_currentRectangle) {
-        m_currentRectangle->draw(painter);
+    return hit;
+}
+
+PickBuffer::Hit Canvas::enclosing(const QPoint& point) const
+{
+    // The smallest shape wins, so one drawn inside another stays reachable
+    PickBuffer::Hit hit;
+    qint64 smallest = std::numeric_limits<qint64>::max();
+    auto consider = [&](const QRect& bounds) {
+        qint64 area = static_cast<qint64>(bounds.width()) * bounds.height();
+        if (area >= smallest) return false;
+        smallest = area;
+        hit = PickBuffer::Hit();
+        hit.handle = PickBuffer::Interior;
+        return true;
+    };
+    const QRect at(point, QSize(1, 1));
+    if (m_isFillMode) {
+        for (Circle* circle : m_circleIndex.overlapping(at)) {
+            if (circle->encloses(point) && consider(circle->boundingRect())) hit.circle = circle;
+        }
     }
+    for (Polygon* polygon : m_polygonIndex.overlapping(at)) {
+        if (polygon->contains(point) && consider(polygon->boundingRect())) hit.polygon = polygon;
+    }
+    for (Rectangle* rect : m_rectangleIndex.overlapping(at)) {
+        if (rect->contains(point) && consider(rect->boundingRect())) hit.rectangle = rect;
+    }
+    return hit;
+}
+
+std::vector<QPoint> Canvas::snapTargets(const Line* line)
+{
+    return { line->getStartPoint(), line->getEndPoint() };
+}
+
+std::vector<QPoint> Canvas::snapTargets(const Rectangle* rect)
+{
+    return { rect->getVertex(0), rect->getVertex(1), rect->getVertex(2), rect->getVertex(3) };
+}
+
+QPoint Canvas::snapped(const QPoint& point, const void* exclude) const
+{
+    QPoint vertex;
+    if (m_isSnapMode && m_vertexGrid.nearest(point, SNAP_RADIUS, exclude, vertex)) {
+        return vertex;
+    }
+    return point;
+}
+
+void Canvas::paintEvent(QPaintEvent *event)
+{
+    // Rendering happens on m_renderer's thread: hand it the current scene
+    // and show the last frame it finished. Its frameReady() repaints the
+    // changed part again, which only presents that frame.
+    if (m_isSceneChanged || size() != m_submittedSize) {
+        m_renderer.submit(snapshot(event->region()));
+        m_isSceneChanged = false;
+        m_submittedSize = size();
+    }
+    QPainter painter(this);
+    m_renderer.present(painter, event->region());
+}
+
+namespace {
+
+template <class Shape>
+void sendDrawing(const Shape* shape, std::unordered_map<const void*, quint64>& previous,
+                 std::unordered_map<const void*, quint64>& sent, std::vector<RenderThread::Item<Shape>>& items)
+{
+    if (!shape) return;
+    quint64 version = previous[shape];
+    items.push_back(RenderThread::item(shape, version));
+    sent[shape] = version;
+}
+
+} // namespace
+
+template <class Shape>
+void Canvas::takeChanges(Dirty<Shape>& dirty, RenderThread::Changes<Shape>& changes)
+{
+    changes.removed = std::move(dirty.removed);
+    for (const Shape* shape : dirty.changed) {
+        auto sent = m_sentVersions.find(shape);
+        if (sent != m_sentVersions.end()) {
+            changes.updated.push_back(RenderThread::item(shape, sent->second));
+        } else {
+            changes.added.push_back(RenderThread::item(shape, m_sentVersions[shape]));
+        }
+    }
+    dirty.removed.clear();
+    dirty.changed.clear();
+}
+
+template <class Shape>
+void Canvas::resendShapes(const std::vector<std::unique_ptr<Shape>>& shapes, Dirty<Shape>& dirty,
+                          std::unordered_map<const void*, quint64>& previous, RenderThread::Changes<Shape>& changes)
+{
+    changes.added.reserve(shapes.size());
+    for (const auto& shape : shapes) {
+        quint64 version = previous[shape.get()];
+        changes.added.push_back(RenderThread::item(shape.get(), version));
+        m_sentVersions.emplace(shape.get(), version);
+    }
+    dirty.removed.clear();
+    dirty.changed.clear();
+}
+
+RenderThread::Scene Canvas::snapshot(const QRegion& damage)
+{
+    // Only shapes listed, edited or unlisted since the last scene are sent,
+    // and only edited ones are copied; the render thread moves its own copy
+    // of the rest
+    RenderThread::Scene scene;
+    scene.size = size();
+    scene.damage = damage;
+    if (m_isSceneReset) {
+        std::unordered_map<const void*, quint64> previous;
+        previous.swap(m_sentVersions);
+        resendShapes(m_lines, m_dirtyLines, previous, scene.shapes.lines);
+        resendShapes(m_circles, m_dirtyCircles, previous, scene.shapes.circles);
+        resendShapes(m_polygons, m_dirtyPolygons, previous, scene.shapes.polygons);
+        resendShapes(m_rectangles, m_dirtyRectangles, previous, scene.shapes.rectangles);
+        scene.reset = true;
+        m_isSceneReset = false;
+    } else {
+        takeChanges(m_dirtyLines, scene.shapes.lines);
+        takeChanges(m_dirtyCircles, scene.shapes.circles);
+        takeChanges(m_dirtyPolygons, scene.shapes.polygons);
+        takeChanges(m_dirtyRectangles, scene.shapes.rectangles);
+    }
+    std::unordered_map<const void*, quint64> drawn;
+    drawn.swap(m_sentDrawingVersions);
+    sendDrawing(m_currentLine, drawn, m_sentDrawingVersions, scene.drawing.lines);
+    sendDrawing(m_currentCircle, drawn, m_sentDrawingVersions, scene.drawing.circles);
+    sendDrawing(m_currentPolygon, drawn, m_sentDrawingVersions, scene.drawing.polygons);
+    sendDrawing(m_currentRectangle, drawn, m_sentDrawingVersions, scene.drawing.rectangles);
+    if (m_isBackgroundFrozen) {
+        const void* selected[] = { m_selectedLine, m_selectedCircle, m_selectedPolygon, m_selectedRectangle };
+        for (const void* shape : selected) {
+            if (shape) scene.dragged.push_back(shape);
+        }
+    }
+    return scene;
+}
+
+QRect Canvas::selectedBounds() const
+{
+    QRect bounds;
+    if (m_selectedLine) bounds |= m_selectedLine->boundingRect();
+    if (m_selectedCircle) bounds |= m_selectedCircle->boundingRect();
+    if (m_selectedPolygon) bounds |= m_selectedPolygon->boundingRect();
+    if (m_selectedRectangle) bounds |= m_selectedRectangle->boundingRect();
+    return bounds;
+}
+
+void Canvas::freezeBackground()
+{
+    // Nothing but the selected shape changes until the button is released,
+    // so the renderer keeps everything else as one frozen layer meanwhile
+    m_isBackgroundFrozen = true;
+    m_isSceneChanged = true;
 }
 
 void Canvas::mousePressEvent(QMouseEvent *event)
 {
+    // The topmost shape part under the cursor decides what a click does
+    const PickBuffer::Hit hit = pick(event->pos());
+
     // First handle clipping mode separately
     if (m_isClippingMode) {
         if (event->button() == Qt::LeftButton) {
             // Left-click to add a polygon to clip chain
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(event->pos())) {
-                    processClippingWithPolygon(polygon.get());
-                    return;
-                }
+            if (hit.polygon) {
+                processClippingWithPolygon(hit.polygon);
+                return;
             }
         } else if (event->button() == Qt::RightButton) {
             // Finalize clipping
@@ -94,75 +294,77 @@ void Canvas::mousePressEvent(QMouseEvent *event)
         
         if (m_isColorMode) {
             // Check for line selection
-            for (const auto& line : m_lines) {
-                if (line->contains(m_lastPoint)) {
-                    QColor color = QColorDialog::getColor(line->getColor(), this, "Select Color");
-                    if (color.isValid()) {
-                        line->setColor(color);
-                        update();
-                    }
-                    return;
+            if (Line* line = hit.line) {
+                QColor color = QColorDialog::getColor(line->getColor(), this, "Select Color");
+                if (color.isValid()) {
+                    editShape(line, [&] { line->setColor(color); });
                 }
+                return;
             }
             
-            // Check for circle selection
-            for (const auto& circle : m_circles) {
-                if (circle->contains(m_lastPoint)) {
-                    QColor color = QColorDialog::getColor(circle->getColor(), this, "Select Color");
-                    if (color.isValid()) {
-                        circle->setColor(color);
-                        update();
-                    }
-                    return;
+            // Check for circle selection (by its outline or handles)
+            if (Circle* circle = hit.handle != PickBuffer::Interior ? hit.circle : nullptr) {
+                QColor color = QColorDialog::getColor(circle->getColor(), this, "Select Color");
+                if (color.isValid()) {
+                    editShape(circle, [&] { circle->setColor(color); });
                 }
+                return;
             }
             
             // Check for polygon selection
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(m_lastPoint)) {
-                    QColor color = QColorDialog::getColor(polygon->getColor(), this, "Select Color");
-                    if (color.isValid()) {
-                        polygon->setColor(color);
-                        update();
-                    }
-                    return;
+            if (Polygon* polygon = hit.polygon) {
+                QColor color = QColorDialog::getColor(polygon->getColor(), this, "Select Color");
+                if (color.isValid()) {
+                    editShape(polygon, [&] { polygon->setColor(color); });
                 }
+                return;
             }
             
             // Check for rectangle selection
-            for (const auto& rect : m_rectangles) {
-                if (rect->contains(m_lastPoint)) {
-                    QColor color = QColorDialog::getColor(rect->getColor(), this, "Select Color");
-                    if (color.isValid()) {
-                        rect->setColor(color);
-                        update();
-                    }
-                    return;
+            if (Rectangle* rect = hit.rectangle) {
+                QColor color = QColorDialog::getColor(rect->getColor(), this, "Select Color");
+                if (color.isValid()) {
+                    editShape(rect, [&] { rect->setColor(color); });
                 }
+                return;
             }
         } else if (m_isFillMode) {
             // Toggle fill or change fill color on polygon click
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(m_lastPoint)) {
+            if (Polygon* polygon = hit.polygon) {
+                editShape(polygon, [&] {
                     if (!polygon->isFilled()) {
                         QColor color = QColorDialog::getColor(Qt::yellow, this, "Select Fill Color");
                         if (color.isValid()) {
                             polygon->setFillColor(color);
                         }
+                        applyFillStyle(*polygon);
                         polygon->setFilled(true);
                     } else {
                         // already filled: toggle off
                         polygon->setFilled(false);
                     }
-                    update();
-                    return;
-                }
+                });
+                return;
+            }
+            if (Circle* circle = hit.circle) {
+                editShape(circle, [&] {
+                    if (!circle->isFilled()) {
+                        QColor color = QColorDialog::getColor(Qt::yellow, this, "Select Fill Color");
+                        if (color.isValid()) {
+                            circle->setFillColor(color);
+                        }
+                        circle->setFilled(true);
+                    } else {
+                        circle->setFilled(false);
+                    }
+                });
+                return;
             }
         } else if (m_isImageFillMode) {
             // Fill polygon with image
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(m_lastPoint)) {
-                    QString imgPath = QFileDialog::getOpenFileName(this, "Select Fill Image", "", "Image Files (*.png *.jpg *.bmp)");
+            if (Polygon* polygon = hit.polygon) {
+                QString imgPath = QFileDialog::getOpenFileName(this, "Select Fill Image", "", "Image Files (*.png *.jpg *.bmp)");
+                editShape(polygon, [&] {
                     if (!imgPath.isEmpty()) {
                         QImage img(imgPath);
                         if (!img.isNull()) {
@@ -176,13 +378,13 @@ void Canvas::mousePressEvent(QMouseEvent *event)
                             polygon->setImageFilled(false);
                         }
                     }
-                    update();
-                    return;
-                }
+                });
+                return;
             }
         } else if (m_isDrawing) {
             // Start drawing a new line
-            m_currentLine = new Line(m_lastPoint, m_lastPoint);
+            QPoint start = snapped(m_lastPoint);
+            m_currentLine = new Line(start, start);
             qDebug() << "Started new line";
         } else if (m_isCircleMode) {
             // Start drawing a new circle
@@ -196,7 +398,8 @@ void Canvas::mousePressEvent(QMouseEvent *event)
             if (!m_currentPolygon) {
                 // Start a new polygon
                 m_currentPolygon = new Polygon();
-                m_currentPolygon->addVertex(m_lastPoint);
+                m_currentPolygon->setFillRule(m_fillRule);
+                m_currentPolygon->addVertex(snapped(m_lastPoint));
                 qDebug() << "Started new polygon";
             } else {
                 // Check if we're closing the polygon
@@ -216,176 +419,97 @@ void Canvas::mousePressEvent(QMouseEvent *event)
                 }
                 
                 // Add new vertex
-                m_currentPolygon->addVertex(m_lastPoint);
+                m_currentPolygon->addVertex(snapped(m_lastPoint));
                 qDebug() << "Added vertex to polygon";
             }
-            update(); // Force update to show the current polygon
-        } else if (m_isThicknessMode) {
-            // Check if we clicked on a line or polygon or rectangle to change thickness
-            for (const auto& line : m_lines) {
-                if (line->contains(m_lastPoint)) {
-                    handleThicknessChange(line.get(), true);
-                    break;
-                }
-            }
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(m_lastPoint)) {
-                    handlePolygonThicknessChange(polygon.get(), true);
-                    break;
-                }
-            }
-            for (const auto& rect : m_rectangles) {
-                if (rect->contains(m_lastPoint)) {
-                    handleRectangleThicknessChange(rect.get(), true);
-                    break;
-                }
+            if (m_currentPolygon) {
+                // Adding a vertex only grows the outline
+                invalidate(m_currentPolygon->boundingRect());
             }
+        } else if (m_isThicknessMode) {
+            // Thicken the shape clicked on (a circle by its outline or handles)
+            changeThickness(hit, true);
         } else {
-            // Check for polygon vertex/edge selection
-            for (const auto& polygon : m_polygons) {
-                int vertexIndex;
-                if (polygon->isNearVertex(m_lastPoint, vertexIndex)) {
-                    m_selectedPolygon = polygon.get();
-                    m_selectedVertexIndex = vertexIndex;
-                    m_isDraggingVertex = true;
-                    qDebug() << "Selected polygon vertex";
-                    return;
-                }
-                
-                int edgeIndex;
-                if (polygon->isNearEdge(m_lastPoint, edgeIndex)) {
-                    m_selectedPolygon = polygon.get();
-                    m_selectedEdgeIndex = edgeIndex;
-                    m_isDraggingEdge = true;
-                    qDebug() << "Selected polygon edge";
-                    return;
-                }
-
-                // Check for polygon interior (for whole polygon dragging)
-                if (polygon->contains(m_lastPoint)) {
-                    m_selectedPolygon = polygon.get();
-                    m_isDraggingPolygon = true;
-                    qDebug() << "Selected polygon for dragging";
-                    return;
-                }
-            }
-            
-            // Check for circle operations
-            if (!m_selectedPolygon) {
-                for (const auto& circle : m_circles) {
-                    if (circle->isNearCenter(m_lastPoint)) {
-                        m_selectedCircle = circle.get();
-                        m_isDraggingCenter = true;
-                        qDebug() << "Selected circle center";
-                        break;
-                    } else if (circle->isNearRadius(m_lastPoint)) {
-                        m_selectedCircle = circle.get();
-                        m_isDraggingRadius = true;
-                        qDebug() << "Selected circle radius";
-                        break;
-                    }
-                }
-            }
-            
-            // Check for line operations
-            if (!m_selectedPolygon && !m_selectedCircle) {
-                for (const auto& line : m_lines) {
-                    bool isStart;
-                    if (line->isNearEndpoint(m_lastPoint, isStart)) {
-                        m_selectedLine = line.get();
-                        m_isDraggingEndpoint = true;
-                        m_isDraggingStartPoint = isStart;
-                        qDebug() << "Selected endpoint of line";
-                        break;
-                    }
+            // Start dragging the part of the shape under the cursor
+            int index;
+            bool isStart;
+            if (hit.polygon && hit.handle == PickBuffer::Vertex && hit.polygon->isNearVertex(m_lastPoint, index)) {
+                m_selectedPolygon = hit.polygon;
+                m_selectedVertexIndex = index;
+                m_isDraggingVertex = true;
+                qDebug() << "Selected polygon vertex";
+            } else if (hit.polygon && hit.handle == PickBuffer::Edge && hit.polygon->isNearEdge(m_lastPoint, index)) {
+                m_selectedPolygon = hit.polygon;
+                m_selectedEdgeIndex = index;
+                m_isDraggingEdge = true;
+                qDebug() << "Selected polygon edge";
+            } else if (hit.polygon && hit.handle == PickBuffer::Interior) {
+                // Whole polygon dragging
+                m_selectedPolygon = hit.polygon;
+                m_isDraggingPolygon = true;
+                qDebug() << "Selected polygon for dragging";
+            } else if (hit.circle && hit.handle == PickBuffer::Vertex) {
+                m_selectedCircle = hit.circle;
+                if (hit.circle->isNearCenter(m_lastPoint)) {
+                    m_isDraggingCenter = true;
+                    qDebug() << "Selected circle center";
+                } else {
+                    m_isDraggingRadius = true;
+                    qDebug() << "Selected circle radius";
                 }
+            } else if (hit.line && hit.handle == PickBuffer::Vertex && hit.line->isNearEndpoint(m_lastPoint, isStart)) {
+                m_selectedLine = hit.line;
+                m_isDraggingEndpoint = true;
+                m_isDraggingStartPoint = isStart;
+                qDebug() << "Selected endpoint of line";
+            } else if (hit.rectangle && hit.handle == PickBuffer::Vertex && hit.rectangle->isNearVertex(m_lastPoint, index)) {
+                m_selectedRectangle = hit.rectangle;
+                m_selectedRectVertexIndex = index;
+                m_isDraggingRectVertex = true;
+                qDebug() << "Selected rectangle vertex";
+            } else if (hit.rectangle && hit.handle == PickBuffer::Edge && hit.rectangle->isNearEdge(m_lastPoint, index)) {
+                m_selectedRectangle = hit.rectangle;
+                m_selectedRectEdgeIndex = index;
+                m_isDraggingRectEdge = true;
+                qDebug() << "Selected rectangle edge";
+            } else if (hit.rectangle && hit.handle == PickBuffer::Interior) {
+                m_selectedRectangle = hit.rectangle;
+                m_isDraggingRectangle = true;
+                qDebug() << "Selected rectangle for dragging";
             }
 
-            // Check for rectangle operations
-            if (!m_selectedPolygon) {
-                for (const auto& rect : m_rectangles) {
-                    int vIdx;
-                    if (rect->isNearVertex(m_lastPoint, vIdx)) {
-                        m_selectedRectangle = rect.get();
-                        m_selectedRectVertexIndex = vIdx;
-                        m_isDraggingRectVertex = true;
-                        qDebug() << "Selected rectangle vertex";
-                        return;
-                    }
-                    int eIdx;
-                    if (rect->isNearEdge(m_lastPoint, eIdx)) {
-                        m_selectedRectangle = rect.get();
-                        m_selectedRectEdgeIndex = eIdx;
-                        m_isDraggingRectEdge = true;
-                        qDebug() << "Selected rectangle edge";
-                        return;
-                    }
-                    if (rect->contains(m_lastPoint)) {
-                        m_selectedRectangle = rect.get();
-                        m_isDraggingRectangle = true;
-                        qDebug() << "Selected rectangle for dragging";
-                        return;
-                    }
-                }
+            if (m_selectedLine || m_selectedCircle || m_selectedPolygon || m_selectedRectangle) {
+                freezeBackground();
             }
         }
     } else if (event->button() == Qt::RightButton) {
         if (m_isDrawing) {
             // Remove line
-            for (const auto& line : m_lines) {
-                if (line->contains(event->pos())) {
-                    removeLine(line.get());
-                    qDebug() << "Line removed";
-                    break;
-                }
+            if (hit.line) {
+                removeLine(hit.line);
+                qDebug() << "Line removed";
             }
         } else if (m_isCircleMode) {
-            // Remove circle
-            for (const auto& circle : m_circles) {
-                if (circle->contains(event->pos())) {
-                    removeCircle(circle.get());
-                    qDebug() << "Circle removed";
-                    break;
-                }
+            // Remove circle (by its outline or handles)
+            if (hit.circle && hit.handle != PickBuffer::Interior) {
+                removeCircle(hit.circle);
+                qDebug() << "Circle removed";
             }
         } else if (m_isPolygonMode) {
             // Remove polygon
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(event->pos())) {
-                    removePolygon(polygon.get());
-                    qDebug() << "Polygon removed";
-                    break;
-                }
+            if (hit.polygon) {
+                removePolygon(hit.polygon);
+                qDebug() << "Polygon removed";
             }
         } else if (m_isRectangleMode) {
             // Remove rectangle
-            for (const auto& rect : m_rectangles) {
-                if (rect->contains(event->pos())) {
-                    removeRectangle(rect.get());
-                    qDebug() << "Rectangle removed";
-                    break;
-                }
+            if (hit.rectangle) {
+                removeRectangle(hit.rectangle);
+                qDebug() << "Rectangle removed";
             }
         } else if (m_isThicknessMode) {
-            // Decrease thickness lines/polygons/rectangles
-            for (const auto& line : m_lines) {
-                if (line->contains(event->pos())) {
-                    handleThicknessChange(line.get(), false);
-                    break;
-                }
-            }
-            for (const auto& polygon : m_polygons) {
-                if (polygon->contains(event->pos())) {
-                    handlePolygonThicknessChange(polygon.get(), false);
-                    break;
-                }
-            }
-            for (const auto& rect : m_rectangles) {
-                if (rect->contains(event->pos())) {
-                    handleRectangleThicknessChange(rect.get(), false);
-                    break;
-                }
-            }
+            // Decrease thickness of the shape clicked on
+            changeThickness(hit, false);
         }
     }
 }
@@ -394,76 +518,70 @@ void Canvas::mouseMoveEvent(QMouseEvent *event)
 {
     if (m_isDrawing && m_currentLine) {
         // Update the end point of the current line
-        m_currentLine->setEndPoint(event->pos());
+        editShape(m_currentLine, [&] { m_currentLine->setEndPoint(snapped(event->pos())); });
         qDebug() << "Updating line to:" << event->pos();
-        update();
     } else if (m_isCircleMode && m_currentCircle) {
         // Update the radius of the current circle
         int dx = event->pos().x() - m_currentCircle->getCenter().x();
         int dy = event->pos().y() - m_currentCircle->getCenter().y();
         int radius = static_cast<int>(std::sqrt(dx * dx + dy * dy));
-        m_currentCircle->setRadius(radius);
-        update();
+        editShape(m_currentCircle, [&] { m_currentCircle->setRadius(radius); });
     } else if (m_isPolygonMode && m_currentPolygon) {
         // Update the last vertex position during polygon creation
         if (m_currentPolygon->getVertexCount() > 0) {
-            m_currentPolygon->setVertex(m_currentPolygon->getVertexCount() - 1, event->pos());
-            update();
+            editShape(m_currentPolygon, [&] {
+                m_currentPolygon->setVertex(m_currentPolygon->getVertexCount() - 1, snapped(event->pos()));
+            });
         }
     } else if (m_isDraggingCenter && m_selectedCircle) {
         // Move the circle's center
         QPoint offset = event->pos() - m_lastPoint;
-        m_selectedCircle->move(offset);
+        editShape(m_selectedCircle, [&] { m_selectedCircle->move(offset); });
         m_lastPoint = event->pos();
-        update();
     } else if (m_isDraggingRadius && m_selectedCircle) {
         // Change the circle's radius
-        handleRadiusChange(m_selectedCircle, event->pos());
-        update();
+        editShape(m_selectedCircle, [&] { handleRadiusChange(m_selectedCircle, event->pos()); });
     } else if (m_isDraggingEndpoint && m_selectedLine) {
         // Move the selected endpoint
-        if (m_isDraggingStartPoint) {
-            m_selectedLine->setStartPoint(event->pos());
-        } else {
-            m_selectedLine->setEndPoint(event->pos());
-        }
-        update();
+        QPoint point = snapped(event->pos(), m_selectedLine);
+        editShape(m_selectedLine, [&] {
+            if (m_isDraggingStartPoint) {
+                m_selectedLine->setStartPoint(point);
+            } else {
+                m_selectedLine->setEndPoint(point);
+            }
+        });
     } else if (m_isDraggingVertex && m_selectedPolygon) {
         // Move the selected vertex
-        m_selectedPolygon->setVertex(m_selectedVertexIndex, event->pos());
-        update();
+        QPoint point = snapped(event->pos(), m_selectedPolygon);
+        editShape(m_selectedPolygon, [&] { m_selectedPolygon->setVertex(m_selectedVertexIndex, point); });
     } else if (m_isDraggingEdge && m_selectedPolygon) {
         // Move the selected edge
         QPoint offset = event->pos() - m_lastPoint;
-        m_selectedPolygon->moveEdge(m_selectedEdgeIndex, offset);
+        editShape(m_selectedPolygon, [&] { m_selectedPolygon->moveEdge(m_selectedEdgeIndex, offset); });
         m_lastPoint = event->pos();
-        update();
     } else if (m_isDraggingPolygon && m_selectedPolygon) {
         // Move the entire polygon
         QPoint offset = event->pos() - m_lastPoint;
-        m_selectedPolygon->move(offset);
+        editShape(m_selectedPolygon, [&] { m_selectedPolygon->move(offset); });
         m_lastPoint = event->pos();
-        update();
     } else if (m_isRectangleMode && m_currentRectangle) {
         // Update opposite corner while drawing
-        m_currentRectangle->setOppositeCorner(event->pos());
-        update();
+        editShape(m_currentRectangle, [&] { m_currentRectangle->setOppositeCorner(event->pos()); });
     } else if (m_isDraggingRectangle && m_selectedRectangle) {
         // Move the entire rectangle
         QPoint offset = event->pos() - m_lastPoint;
-        m_selectedRectangle->move(offset);
+        editShape(m_selectedRectangle, [&] { m_selectedRectangle->move(offset); });
         m_lastPoint = event->pos();
-        update();
     } else if (m_isDraggingRectVertex && m_selectedRectangle) {
         // Move a rectangle vertex
-        m_selectedRectangle->moveVertex(m_selectedRectVertexIndex, event->pos());
-        update();
+        QPoint point = snapped(event->pos(), m_selectedRectangle);
+        editShape(m_selectedRectangle, [&] { m_selectedRectangle->moveVertex(m_selectedRectVertexIndex, point); });
     } else if (m_isDraggingRectEdge && m_selectedRectangle) {
         // Move rectangle edge
         QPoint offset = event->pos() - m_lastPoint;
-        m_selectedRectangle->moveEdge(m_selectedRectEdgeIndex, offset);
+        editShape(m_selectedRectangle, [&] { m_selectedRectangle->moveEdge(m_selectedRectEdgeIndex, offset); });
         m_lastPoint = event->pos();
-        update();
     }
 }
 
@@ -496,9 +614,20 @@ void Canvas::mouseReleaseEvent(QMouseEvent *event)
         m_isDraggingRectVertex = false;
         m_isDraggingRectEdge = false;
         m_isDraggingRectangle = false;
+
+        // Put the dragged shape back in its stacking order
+        if (m_isBackgroundFrozen) {
+            m_isBackgroundFrozen = false;
+            if (m_selectedLine) updateSnapTargets(m_selectedLine);
+            if (m_selectedPolygon) updateSnapTargets(m_selectedPolygon);
+            if (m_selectedRectangle) updateSnapTargets(m_selectedRectangle);
+            m_isSceneChanged = true;
+            update(selectedBounds());
+        }
         m_selectedLine = nullptr;
         m_selectedCircle = nullptr;
         m_selectedPolygon = nullptr;
+        m_selectedRectangle = nullptr;
         m_selectedVertexIndex = -1;
         m_selectedEdgeIndex = -1;
         m_selectedRectVertexIndex = -1;
@@ -512,13 +641,22 @@ void Canvas::clearCanvas()
     m_circles.clear();
     m_polygons.clear();
     m_rectangles.clear();
-    update();
+    m_lineIndex.clear();
+    m_circleIndex.clear();
+    m_polygonIndex.clear();
+    m_rectangleIndex.clear();
+    m_vertexGrid.clear();
+    m_pickBuffer.clear();
+    invalidate();
 }
 
 void Canvas::addLine(std::unique_ptr<Line> line)
 {
+    invalidate(line->boundingRect());
+    m_lineIndex.insert(line.get());
+    m_vertexGrid.insert(line.get(), snapTargets(line.get()));
+    markAdded(line.get());
     m_lines.push_back(std::move(line));
-    update();
 }
 
 void Canvas::removeLine(Line* line)
@@ -527,15 +665,21 @@ void Canvas::removeLine(Line* line)
         [line](const std::unique_ptr<Line>& l) { return l.get() == line; });
     
     if (it != m_lines.end()) {
+        invalidate((*it)->boundingRect());
+        m_lineIndex.remove(it->get());
+        m_vertexGrid.remove(it->get());
+        m_pickBuffer.forget(it->get());
+        markRemoved(it->get());
         m_lines.erase(it);
-        update();
     }
 }
 
 void Canvas::addCircle(std::unique_ptr<Circle> circle)
 {
+    invalidate(circle->boundingRect());
+    m_circleIndex.insert(circle.get());
+    markAdded(circle.get());
     m_circles.push_back(std::move(circle));
-    update();
 }
 
 void Canvas::removeCircle(Circle* circle)
@@ -544,15 +688,21 @@ void Canvas::removeCircle(Circle* circle)
         [circle](const std::unique_ptr<Circle>& c) { return c.get() == circle; });
     
     if (it != m_circles.end()) {
+        invalidate((*it)->boundingRect());
+        m_circleIndex.remove(it->get());
+        m_pickBuffer.forget(it->get());
+        markRemoved(it->get());
         m_circles.erase(it);
-        update();
     }
 }
 
 void Canvas::addPolygon(std::unique_ptr<Polygon> polygon)
 {
+    invalidate(polygon->boundingRect());
+    m_polygonIndex.insert(polygon.get());
+    m_vertexGrid.insert(polygon.get(), snapTargets(polygon.get()));
+    markAdded(polygon.get());
     m_polygons.push_back(std::move(polygon));
-    update();
 }
 
 void Canvas::removePolygon(Polygon* polygon)
@@ -561,15 +711,22 @@ void Canvas::removePolygon(Polygon* polygon)
         [polygon](const std::unique_ptr<Polygon>& p) { return p.get() == polygon; });
     
     if (it != m_polygons.end()) {
+        invalidate((*it)->boundingRect());
+        m_polygonIndex.remove(it->get());
+        m_vertexGrid.remove(it->get());
+        m_pickBuffer.forget(it->get());
+        markRemoved(it->get());
         m_polygons.erase(it);
-        update();
     }
 }
 
 void Canvas::addRectangle(std::unique_ptr<Rectangle> rect)
 {
+    invalidate(rect->boundingRect());
+    m_rectangleIndex.insert(rect.get());
+    m_vertexGrid.insert(rect.get(), snapTargets(rect.get()));
+    markAdded(rect.get());
     m_rectangles.push_back(std::move(rect));
-    update();
 }
 
 void Canvas::removeRectangle(Rectangle* rect)
@@ -577,8 +734,25 @@ void Canvas::removeRectangle(Rectangle* rect)
     auto it = std::find_if(m_rectangles.begin(), m_rectangles.end(),
         [rect](const std::unique_ptr<Rectangle>& r){ return r.get() == rect; });
     if (it != m_rectangles.end()) {
+        invalidate((*it)->boundingRect());
+        m_rectangleIndex.remove(it->get());
+        m_vertexGrid.remove(it->get());
+        m_pickBuffer.forget(it->get());
+        markRemoved(it->get());
         m_rectangles.erase(it);
-        update();
+    }
+}
+
+void Canvas::changeThickness(const PickBuffer::Hit& hit, bool increase)
+{
+    if (hit.line) {
+        handleThicknessChange(hit.line, increase);
+    } else if (hit.polygon) {
+        handlePolygonThicknessChange(hit.polygon, increase);
+    } else if (hit.rectangle) {
+        handleRectangleThicknessChange(hit.rectangle, increase);
+    } else if (hit.circle && hit.handle != PickBuffer::Interior) {
+        handleCircleThicknessChange(hit.circle, increase);
     }
 }
 
@@ -589,8 +763,7 @@ void Canvas::handleThicknessChange(Line* line, bool increase)
     int currentThickness = line->getThickness();
     int newThickness = increase ? currentThickness + 1 : std::max(1, currentThickness - 1);
     
-    line->setThickness(newThickness);
-    update();
+    editShape(line, [&] { line->setThickness(newThickness); });
     qDebug() << "Line thickness changed to:" << newThickness;
 }
 
@@ -601,8 +774,7 @@ void Canvas::handlePolygonThicknessChange(Polygon* polygon, bool increase)
     int currentThickness = polygon->getThickness();
     int newThickness = increase ? currentThickness + 1 : std::max(1, currentThickness - 1);
     
-    polygon->setThickness(newThickness);
-    update();
+    editShape(polygon, [&] { polygon->setThickness(newThickness); });
     qDebug() << "Polygon thickness changed to:" << newThickness;
 }
 
@@ -623,16 +795,60 @@ void Canvas::handleRectangleThicknessChange(Rectangle* rect, bool increase)
     if (!rect) return;
     int current = rect->getThickness();
     int newT = increase ? current+1 : std::max(1, current-1);
-    rect->setThickness(newT);
-    update();
+    editShape(rect, [&] { rect->setThickness(newT); });
     qDebug() << "Rectangle thickness changed to:" << newT;
 }
 
+void Canvas::handleCircleThicknessChange(Circle* circle, bool increase)
+{
+    if (!circle) return;
+    int current = circle->getThickness();
+    int newT = increase ? current+1 : std::max(1, current-1);
+    editShape(circle, [&] { circle->setThickness(newT); });
+    qDebug() << "Circle thickness changed to:" << newT;
+}
+
 void Canvas::setAntiAliasing(bool enabled)
 {
     m_antiAliasing = enabled;
     updateAllObjectsAntiAliasing();
-    update();
+    invalidate();
+}
+
+void Canvas::setFillRule(Qt::FillRule rule)
+{
+    m_fillRule = rule;
+    for (const auto& polygon : m_polygons) {
+        polygon->setFillRule(m_fillRule);
+    }
+    if (m_currentPolygon) {
+        m_currentPolygon->setFillRule(m_fillRule);
+    }
+    invalidate();
+}
+
+void Canvas::applyFillStyle(Polygon& polygon)
+{
+    if (m_fillStyle == FillShader::Solid || polygon.getVertexCount() == 0) return;
+
+    // Gradients span the polygon's bounding box
+    QRect bounds(polygon.getVertex(0), QSize(1, 1));
+    for (int i = 1; i < polygon.getVertexCount(); ++i) {
+        bounds |= QRect(polygon.getVertex(i), QSize(1, 1));
+    }
+    QColor color = polygon.getFillColor();
+    if (m_fillStyle == FillShader::Hatch) {
+        polygon.setFillShader(FillShader::hatch(Qt::DiagCrossPattern, color));
+        return;
+    }
+    QColor endColor = QColorDialog::getColor(Qt::white, this, "Select Gradient End Color");
+    if (!endColor.isValid()) return;
+    if (m_fillStyle == FillShader::LinearGradient) {
+        polygon.setFillShader(FillShader::linear(bounds.topLeft(), bounds.bottomRight(), color, endColor));
+    } else {
+        int radius = std::max(bounds.width(), bounds.height()) / 2;
+        polygon.setFillShader(FillShader::radial(bounds.center(), radius, color, endColor));
+    }
 }
 
 void Canvas::updateAllObjectsAntiAliasing()
@@ -692,7 +908,7 @@ void Canvas::processClippingWithPolygon(Polygon* selectedPolygon)
         m_clipSelections.clear();
         m_clipResultVertices.clear();
         m_isClippingMode = false;
-        update();
+        invalidate();
         return;
     }
 
@@ -719,7 +935,7 @@ void Canvas::processClippingWithPolygon(Polygon* selectedPolygon)
         selectedPolygon->setColor(Qt::blue);
     }
 
-    update();
+    invalidate();
 }
 
 void Canvas::finalizeClipping()
@@ -735,6 +951,7 @@ void Canvas::finalizeClipping()
         newPoly->close();
         newPoly->setColor(Qt::magenta); // highlight new polygon
         newPoly->setAntiAliasing(m_antiAliasing);
+        newPoly->setFillRule(m_fillRule);
         addPolygon(std::move(newPoly));
         qDebug() << "Clipping finalized, new polygon added";
     } else {
@@ -749,5 +966,5 @@ void Canvas::finalizeClipping()
     }
     m_clippingOldColors.clear();
     m_isClippingMode = false;
-    update();
+    invalidate();
 }
\ No newline at end of file
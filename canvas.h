@@ -9,6 +9,10 @@
 #include "circle.h"
 #include "polygon.h"
 #include "rectangle.h"
+#include "pickbuffer.h"
+#include "renderthread.h"
+#include "spatialgrid.h"
+#include "vertexgrid.h"
 #include <unordered_map>
 
 class Canvas : public QWidget
@@ -29,6 +33,10 @@ public:
     void setFillMode(bool enabled) { m_isFillMode = enabled; }
     void setImageFillMode(bool enabled) { m_isImageFillMode = enabled; }
     void setAntiAliasing(bool enabled);
+    void setFillRule(Qt::FillRule rule);
+    Qt::FillRule fillRule() const { return m_fillRule; }
+    void setFillStyle(FillShader::Type style) { m_fillStyle = style; }
+    void setSnapMode(bool enabled) { m_isSnapMode = enabled; }
     void clearCanvas();
     void addLine(std::unique_ptr<Line> line);
     void removeLine(Line* line);
@@ -62,6 +70,9 @@ private:
     bool m_isFillMode = false;
     bool m_isImageFillMode = false;
     bool m_antiAliasing = false;
+    bool m_isSnapMode = false;
+    Qt::FillRule m_fillRule = Qt::OddEvenFill;
+    FillShader::Type m_fillStyle = FillShader::Solid; // applied by fill mode to polygons
     Line* m_currentLine = nullptr;
     Circle* m_currentCircle = nullptr;
     Polygon* m_currentPolygon = nullptr;
@@ -70,6 +81,11 @@ private:
     std::vector<std::unique_ptr<Circle>> m_circles;
     std::vector<std::unique_ptr<Polygon>> m_polygons;
     std::vector<std::unique_ptr<Rectangle>> m_rectangles;
+    ShapeIndex<Line> m_lineIndex; // hit bounds of the lists above, kept in step by add/remove/editShape
+    ShapeIndex<Circle> m_circleIndex;
+    ShapeIndex<Polygon> m_polygonIndex;
+    ShapeIndex<Rectangle> m_rectangleIndex;
+    VertexGrid m_vertexGrid; // vertices of the lines, polygons and rectangles above, for snapping
     QPoint m_lastPoint;
     bool m_isDraggingEndpoint = false;
     bool m_isDraggingStartPoint = false;
@@ -92,14 +108,89 @@ private:
     std::vector<Polygon*> m_clipSelections;
     std::vector<QPoint> m_clipResultVertices;
     std::unordered_map<Polygon*, QColor> m_clippingOldColors;
+    bool m_isBackgroundFrozen = false;       // see freezeBackground()
+    RenderThread m_renderer;                 // rasterizes snapshot() off the GUI thread
+    bool m_isSceneChanged = true;            // since the last submitted scene
+    bool m_isSceneReset = true;              // next scene resends every shape, see invalidate()
+    QSize m_submittedSize;                   // of the last submitted scene
+    PickBuffer m_pickBuffer;                 // shape part under each pixel, see pick()
+
+    // Shapes of one list to send with the next scene
+    template <class Shape>
+    struct Dirty {
+        std::vector<const Shape*> removed; // ones the render thread has
+        std::vector<const Shape*> changed; // listed or edited, new ones in list order
+    };
+    Dirty<Line> m_dirtyLines; // kept by add/remove/editShape
+    Dirty<Circle> m_dirtyCircles;
+    Dirty<Polygon> m_dirtyPolygons;
+    Dirty<Rectangle> m_dirtyRectangles;
+    std::unordered_map<const void*, quint64> m_sentVersions;        // of each listed shape the render thread has
+    std::unordered_map<const void*, quint64> m_sentDrawingVersions; // of the shapes being drawn
     
+    // Apply edit to shape, reindex it and repaint the union of its old and new bounds
+    template <class Shape, class Edit>
+    void editShape(Shape* shape, Edit edit);
+    // Note for the next scene that shape was listed, edited or unlisted
+    template <class Shape>
+    void markAdded(const Shape* shape) { dirtyOf(shape).changed.push_back(shape); }
+    template <class Shape>
+    void markEdited(const Shape* shape);
+    template <class Shape>
+    void markRemoved(const Shape* shape);
+    Dirty<Line>& dirtyOf(const Line*) { return m_dirtyLines; }
+    Dirty<Circle>& dirtyOf(const Circle*) { return m_dirtyCircles; }
+    Dirty<Polygon>& dirtyOf(const Polygon*) { return m_dirtyPolygons; }
+    Dirty<Rectangle>& dirtyOf(const Rectangle*) { return m_dirtyRectangles; }
+    // Repaint area (everything if null) after shapes in it changed; also
+    // marks it for redrawing in the pick buffer
+    void invalidate(const QRect& area = QRect());
+    // Topmost shape part at point, from the pick buffer brought up to date
+    PickBuffer::Hit pick(const QPoint& point);
+    // Interior of the innermost shape around point, for what the pick
+    // buffer leaves out
+    PickBuffer::Hit enclosing(const QPoint& point) const;
+    ShapeIndex<Line>& indexOf(const Line*) { return m_lineIndex; }
+    ShapeIndex<Circle>& indexOf(const Circle*) { return m_circleIndex; }
+    ShapeIndex<Polygon>& indexOf(const Polygon*) { return m_polygonIndex; }
+    ShapeIndex<Rectangle>& indexOf(const Rectangle*) { return m_rectangleIndex; }
+    // Vertices other shapes snap to; circles have none
+    static std::vector<QPoint> snapTargets(const Line* line);
+    static const std::vector<QPoint>& snapTargets(const Polygon* polygon) { return polygon->getVertices(); }
+    static std::vector<QPoint> snapTargets(const Rectangle* rect);
+    // Skipped for shapes not listed yet (one still being drawn)
+    template <class Shape>
+    void updateSnapTargets(const Shape* shape)
+    {
+        if (m_vertexGrid.contains(shape)) m_vertexGrid.update(shape, snapTargets(shape));
+    }
+    void updateSnapTargets(const Circle*) {}
+    // point moved onto the nearest vertex within SNAP_RADIUS of a shape other
+    // than exclude, in snap mode; point itself otherwise
+    QPoint snapped(const QPoint& point, const void* exclude = nullptr) const;
+    // Everything the render thread needs for the next frame: the shapes
+    // marked since the last one, or all of them after invalidate() of
+    // everything, copying only those edited since they were last sent
+    RenderThread::Scene snapshot(const QRegion& damage);
+    template <class Shape>
+    void takeChanges(Dirty<Shape>& dirty, RenderThread::Changes<Shape>& changes);
+    template <class Shape>
+    void resendShapes(const std::vector<std::unique_ptr<Shape>>& shapes, Dirty<Shape>& dirty,
+                      std::unordered_map<const void*, quint64>& previous, RenderThread::Changes<Shape>& changes);
+    QRect selectedBounds() const;
+    void freezeBackground();
+    void changeThickness(const PickBuffer::Hit& hit, bool increase);
     void handleThicknessChange(Line* line, bool increase);
     void handleRadiusChange(Circle* circle, const QPoint& newPoint);
     void handlePolygonThicknessChange(Polygon* polygon, bool increase);
     void handleRectangleThicknessChange(Rectangle* rect, bool increase);
+    void handleCircleThicknessChange(Circle* circle, bool increase);
+    void applyFillStyle(Polygon& polygon);
     void updateAllObjectsAntiAliasing();
     void processClippingWithPolygon(Polygon* selectedPolygon);
     void finalizeClipping();
+
+    static const int SNAP_RADIUS = 10;
 };
 
 #endif // CANVAS_H
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "capsule.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+struct Interval {
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+
+    bool isEmpty() const { return lo > hi; }
+    void unite(const Interval& other)
+    {
+        if (other.isEmpty()) return;
+        lo = std::min(lo, other.lo);
+        hi = std::max(hi, other.hi);
+    }
+};
+
+struct Segment {
+    double x0, y0, x1, y1;
+    double dx, dy;   // end - start
+    double length;
+    double ux, uy;   // unit direction (0 for a degenerate segment)
+};
+
+// Solve lo <= a * x + b <= hi for x
+Interval solveLinear(double a, double b, double lo, double hi)
+{
+    Interval result;
+    if (std::abs(a) < 1e-12) {
+        if (b >= lo && b <= hi) {
+            result.lo = -std::numeric_limits<double>::infinity();
+            result.hi = std::numeric_limits<double>::infinity();
+        }
+        return result;
+    }
+    double x1 = (lo - b) / a;
+    double x2 = (hi - b) / a;
+    result.lo = std::min(x1, x2);
+    result.hi = std::max(x1, x2);
+    return result;
+}
+
+// Horizontal extent of a disc on row y
+Interval discInterval(double cx, double cy, double r, double y)
+{
+    Interval result;
+    double dy = y - cy;
+    double h = r * r - dy * dy;
+    if (h >= 0) {
+        double w = std::sqrt(h);
+        result.lo = cx - w;
+        result.hi = cx + w;
+    }
+    return result;
+}
+
+// Horizontal extent of the capsule of radius r on row y
+Interval capsuleInterval(const Segment& s, double r, double y)
+{
+    Interval result = discInterval(s.x0, s.y0, r, y);
+    result.unite(discInterval(s.x1, s.y1, r, y));
+
+    if (s.length > 0) {
+        // Rectangle between the caps: 0 <= along <= length, |across| <= r
+        double ry = y - s.y0;
+        Interval along = solveLinear(s.ux, ry * s.uy - s.x0 * s.ux, 0, s.length);
+        Interval across = solveLinear(-s.uy, ry * s.ux + s.x0 * s.uy, -r, r);
+        Interval body;
+        body.lo = std::max(along.lo, across.lo);
+        body.hi = std::min(along.hi, across.hi);
+        result.unite(body);
+    }
+    return result;
+}
+
+double distanceToSegment(const Segment& s, double px, double py)
+{
+    double t = 0;
+    if (s.length > 0) {
+        t = ((px - s.x0) * s.dx + (py - s.y0) * s.dy) / (s.length * s.length);
+        t = std::clamp(t, 0.0, 1.0);
+    }
+    double ex = px - (s.x0 + t * s.dx);
+    double ey = py - (s.y0 + t * s.dy);
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+} // namespace
+
+void drawCapsule(CoverageMask& mask, const QPoint& start, const QPoint& end, float radius)
+{
+    Segment s;
+    s.x0 = start.x();
+    s.y0 = start.y();
+    s.x1 = end.x();
+    s.y1 = end.y();
+    s.dx = s.x1 - s.x0;
+    s.dy = s.y1 - s.y0;
+    s.length = std::sqrt(s.dx * s.dx + s.dy * s.dy);
+    s.ux = s.length > 0 ? s.dx / s.length : 0;
+    s.uy = s.length > 0 ? s.dy / s.length : 0;
+
+    // Pixels within r - 0.5 are fully covered, beyond r + 0.5 not at all
+    double outer = radius + 0.5;
+    double inner = radius - 0.5;
+
+    const QRect& clip = mask.bounds();
+    int top = std::max(clip.top(), static_cast<int>(std::floor(std::min(s.y0, s.y1) - outer)));
+    int bottom = std::min(clip.bottom(), static_cast<int>(std::ceil(std::max(s.y0, s.y1) + outer)));
+    int minX = clip.left();
+    int maxX = clip.right();
+
+    for (int y = top; y <= bottom; ++y) {
+        Interval outerSpan = capsuleInterval(s, outer, y);
+        if (outerSpan.isEmpty()) continue;
+        int x0 = std::max(minX, static_cast<int>(std::ceil(outerSpan.lo)));
+        int x1 = std::min(maxX, static_cast<int>(std::floor(outerSpan.hi)));
+        if (x1 < x0) continue;
+
+        // Fully covered interior, written as a single span
+        int innerStart = x1 + 1;
+        int innerEnd = x1;
+        if (inner > 0) {
+            Interval innerSpan = capsuleInterval(s, inner, y);
+            if (!innerSpan.isEmpty()) {
+                innerStart = std::max(x0, static_cast<int>(std::ceil(innerSpan.lo)));
+                innerEnd = std::min(x1, static_cast<int>(std::floor(innerSpan.hi)));
+            }
+        }
+        if (innerEnd < innerStart) {
+            innerStart = x1 + 1;
+            innerEnd = x1;
+        }
+
+        // Partially covered edge pixels on either side of the interior
+        auto blendEdge = [&](int from, int to) {
+            for (int x = from; x <= to; ++x) {
+                double coverage = outer - distanceToSegment(s, x, y);
+                mask.add(x, y, static_cast<int>(std::clamp(coverage, 0.0, 1.0) * 255.0 + 0.5));
+            }
+        };
+        blendEdge(x0, innerStart - 1);
+        if (innerStart <= innerEnd) {
+            mask.addSpan(innerStart, innerEnd, y, 255);
+            blendEdge(innerEnd + 1, x1);
+        }
+    }
+}
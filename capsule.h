@@ -0,0 +1,14 @@
+#ifndef CAPSULE_H
+#define CAPSULE_H
+
+#include <QPoint>
+#include "coveragemask.h"
+
+// Anti-aliased thick segment rasterizer.
+// Scan-converts the capsule swept by a disc of the given radius along
+// start-end into a coverage mask. Each scanline computes the covered x-range
+// analytically, records the fully covered interior as one span and derives
+// the coverage of the few edge pixels from their distance to the segment.
+void drawCapsule(CoverageMask& mask, const QPoint& start, const QPoint& end, float radius);
+
+#endif // CAPSULE_H
@@ -1,6 +1,7 @@
 #include "circle.h"
-#include <QPainter>
+#include <algorithm>
 #include <cmath>
+#include <vector>
 #include <QDebug>
 
 Circle::Circle(const QPoint& center, int radius)
@@ -9,36 +10,27 @@ Circle::Circle(const QPoint& center, int radius)
     qDebug() << "Circle created with center:" << center << "and radius:" << radius;
 }
 
-void Circle::draw(QPainter& painter)
-{
-    if (m_antiAliasing) {
-        drawWuCircle(painter);
-    } else {
-        painter.setPen(QPen(m_color, 1));
-        drawMidpointCircle(painter);
-    }
-    drawCenter(painter);
-    drawRadiusPoint(painter);
-}
+namespace {
 
-void Circle::drawMidpointCircle(QPainter& painter)
+// Per-row extent of the midpoint circle of the given radius: row dy (0..radius)
+// of the first quadrant covers columns lo[dy]..hi[dy] (always one contiguous run)
+void midpointRows(int radius, std::vector<int>& lo, std::vector<int>& hi)
 {
+    lo.assign(radius + 1, radius + 1);
+    hi.assign(radius + 1, -1);
+    auto record = [&](int x, int y) {
+        lo[y] = std::min(lo[y], x);
+        hi[y] = std::max(hi[y], x);
+        lo[x] = std::min(lo[x], y);
+        hi[x] = std::max(hi[x], y);
+    };
+
     int x = 0;
-    int y = m_radius;
-    int d = 1 - m_radius;
+    int y = radius;
+    int d = 1 - radius;
     int dE = 3;
-    int dSE = 5 - 2 * m_radius;
-
-    // Draw the initial points
-    painter.drawPoint(m_center.x() + x, m_center.y() + y);
-    painter.drawPoint(m_center.x() - x, m_center.y() + y);
-    painter.drawPoint(m_center.x() + x, m_center.y() - y);
-    painter.drawPoint(m_center.x() - x, m_center.y() - y);
-    painter.drawPoint(m_center.x() + y, m_center.y() + x);
-    painter.drawPoint(m_center.x() - y, m_center.y() + x);
-    painter.drawPoint(m_center.x() + y, m_center.y() - x);
-    painter.drawPoint(m_center.x() - y, m_center.y() - x);
-
+    int dSE = 5 - 2 * radius;
+    record(x, y);
     while (y > x) {
         if (d < 0) { // Move to E
             d += dE;
@@ -51,88 +43,284 @@ void Circle::drawMidpointCircle(QPainter& painter)
             --y;
         }
         ++x;
+        record(x, y);
+    }
+}
 
-        // Draw all eight octants
-        painter.drawPoint(m_center.x() + x, m_center.y() + y);
-        painter.drawPoint(m_center.x() - x, m_center.y() + y);
-        painter.drawPoint(m_center.x() + x, m_center.y() - y);
-        painter.drawPoint(m_center.x() - x, m_center.y() - y);
-        painter.drawPoint(m_center.x() + y, m_center.y() + x);
-        painter.drawPoint(m_center.x() - y, m_center.y() + x);
-        painter.drawPoint(m_center.x() + y, m_center.y() - x);
-        painter.drawPoint(m_center.x() - y, m_center.y() - x);
+// Fill the columns inner < |dx| <= outer on rows cy - dy and cy + dy
+// (inner < 0 gives a single solid span)
+void fillRowPair(Framebuffer& fb, const QPoint& center, int dy, int inner, int outer, QRgb color)
+{
+    if (outer <= inner) return;
+    for (int y : {center.y() - dy, center.y() + dy}) {
+        if (inner < 0) {
+            fb.fillSpan(center.x() - outer, center.x() + outer, y, color);
+        } else {
+            fb.fillSpan(center.x() - outer, center.x() - inner - 1, y, color);
+            fb.fillSpan(center.x() + inner + 1, center.x() + outer, y, color);
+        }
+        if (dy == 0) break;
+    }
+}
+
+// round(255 * T) where T = sqrt(s) - (x - 1) is in (0, 1] and e = s - (x - 1)^2.
+// e / (2x - 1) underestimates T by at most 1 / (4(2x - 1)), so it is a close
+// starting point that a few exact integer comparisons (usually none) round up.
+// The products stay within 64 bits for radii up to about 1.7 million.
+int wuCoverage(qint64 s, int x, qint64 e)
+{
+    const qint64 width = 2 * static_cast<qint64>(x) - 1;
+    int coverage = static_cast<int>(e * 255 / width);
+    const qint64 target = s * 510 * 510; // (510 * sqrt(s))^2
+    const qint64 base = 510 * static_cast<qint64>(x - 1);
+
+    // Round up while 255 * T >= coverage + 0.5
+    while (coverage < 255) {
+        qint64 threshold = base + 2 * coverage + 1;
+        if (threshold * threshold > target) break;
+        ++coverage;
     }
+    return coverage;
 }
 
-void Circle::drawWuCircle(QPainter& painter)
+} // namespace
+
+void Circle::draw(Framebuffer& fb)
 {
+    m_sprite.draw(fb, *this);
+}
+
+void Circle::prepareDraw(const Framebuffer&)
+{
+    m_sprite.prepare(*this);
+}
+
+void Circle::paint(Framebuffer& fb)
+{
+    m_sprite.paint(fb, *this);
+}
+
+void Circle::render(Framebuffer& fb)
+{
+    QRgb fillColor = m_isFilled ? Framebuffer::premultiply(m_fillColor) : 0;
+    if (m_antiAliasing) {
+        if (fillColor) fillDisc(fb, fillColor);
+        if (m_thickness > 1) {
+            drawAntiAliasedRing(fb);
+        } else {
+            drawWuCircle(fb);
+        }
+    } else {
+        drawSpans(fb, fillColor, Framebuffer::premultiply(m_color));
+    }
+    QRgb black = Framebuffer::premultiply(Qt::black);
+    drawCenter(fb, black);
+    drawRadiusPoint(fb, black);
+}
+
+void Circle::drawPick(Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles) const
+{
+    drawSpans(fb, m_isFilled ? interior : 0, outline);
+    if (handles) {
+        drawCenter(fb, handles);
+        drawRadiusPoint(fb, handles);
+    }
+}
+
+void Circle::drawSpans(Framebuffer& fb, QRgb fillColor, QRgb outlineColor) const
+{
+    if (!fillColor && !outlineColor) return;
+
+    // Outer and inner boundary of the outline ring, per row. A 1px outline is
+    // exactly the midpoint circle; thicker ones span the difference of two
+    // midpoint discs. Either way each row is written as symmetric spans.
+    thread_local std::vector<int> outerLo, outerHi, innerLo, innerHi;
+    int outerRadius = m_radius + m_thickness / 2;
+    int innerRadius = outerRadius - m_thickness;
+    midpointRows(outerRadius, outerLo, outerHi);
+    if (m_thickness > 1 && innerRadius >= 0) {
+        midpointRows(innerRadius, innerLo, innerHi);
+    }
+
+    // Only rows that can reach the framebuffer
+    int first = std::max(0, std::max(m_center.y() - fb.height() + 1, -m_center.y()));
+    for (int dy = first; dy <= outerRadius; ++dy) {
+        if (m_center.y() - dy < 0 && m_center.y() + dy >= fb.height()) break;
+
+        // Columns |dx| <= inner belong to the interior
+        int inner;
+        if (m_thickness > 1) {
+            inner = dy <= innerRadius ? innerHi[dy] : -1;
+        } else {
+            inner = outerLo[dy] - 1;
+        }
+
+        if (fillColor && inner >= 0) {
+            fillRowPair(fb, m_center, dy, -1, inner, fillColor);
+        }
+        if (outlineColor) {
+            fillRowPair(fb, m_center, dy, inner, outerHi[dy], outlineColor);
+        }
+    }
+}
+
+void Circle::fillDisc(Framebuffer& fb, QRgb color) const
+{
+    // The anti-aliased outline is opaque or partially covers everything past
+    // the radius, never less, so filling every pixel center within it leaves
+    // no background showing through between the fill and the outline
+    const qint64 radiusSquared = static_cast<qint64>(m_radius) * m_radius;
+    int x = m_radius; // floor(sqrt(r^2 - dy^2)), stepped down as dy grows
+    int first = std::max(0, std::max(m_center.y() - fb.height() + 1, -m_center.y()));
+    for (int dy = first; dy <= m_radius; ++dy) {
+        if (m_center.y() - dy < 0 && m_center.y() + dy >= fb.height()) break;
+        const qint64 rest = radiusSquared - static_cast<qint64>(dy) * dy;
+        while (static_cast<qint64>(x) * x > rest) {
+            --x;
+        }
+        fillRowPair(fb, m_center, dy, -1, x, color);
+    }
+}
+
+void Circle::drawWuCircle(Framebuffer& fb)
+{
+    // Incremental integer Wu circle. For each row y of the octant x >= y the
+    // ideal boundary sqrt(r^2 - y^2) lies in (x - 1, x]; x is stepped down
+    // with exact 64-bit comparisons instead of a per-step sqrt, and the
+    // fractional part T (the coverage of pixel x - 1) is derived from the
+    // residual e = s - (x - 1)^2, which satisfies e = T * (2(x - 1) + T).
+    const qint64 r = m_radius;
+    qint64 s = r * r; // r^2 - y^2
     int x = m_radius;
     int y = 0;
     
+    // Collect coverage first so octant seams are not blended twice
+    CoverageMask& mask = CoverageMask::scratch();
+    mask.reset(QRect(m_center.x() - m_radius - 1, m_center.y() - m_radius - 1,
+                     2 * m_radius + 3, 2 * m_radius + 3), fb.clipRect());
+    if (mask.isEmpty()) return;
+    
     // Draw the initial points
-    plotPoints(painter, x, y, 1.0f);
+    plotPoints(mask, x, y, 255);
     
     while (x > y) {
         y++;
-        x = static_cast<int>(std::ceil(std::sqrt(m_radius * m_radius - y * y)));
+        s -= 2 * static_cast<qint64>(y) - 1;
+        if (s <= 0) break; // only reached for r = 1
+        
+        // x = ceil(sqrt(s))
+        qint64 below = static_cast<qint64>(x - 1) * (x - 1);
+        while (below >= s) {
+            --x;
+            below = static_cast<qint64>(x - 1) * (x - 1);
+        }
         
-        // Calculate intensity
-        float T = std::sqrt(m_radius * m_radius - y * y) - (x - 1);
+        int coverage = wuCoverage(s, x, s - below);
         
         // Draw the points with anti-aliasing
-        plotPoints(painter, x, y, 1.0f - T);
-        plotPoints(painter, x - 1, y, T);
+        plotPoints(mask, x, y, 255 - coverage);
+        plotPoints(mask, x - 1, y, coverage);
     }
+    mask.composite(fb, Framebuffer::premultiply(m_color));
 }
 
-void Circle::plotPoints(QPainter& painter, int x, int y, float intensity)
+void Circle::drawAntiAliasedRing(Framebuffer& fb)
+{
+    // Analytic annulus of width m_thickness centered on the radius. A pixel's
+    // coverage is how far its center lies inside the nearer boundary, so each
+    // row only evaluates distances for its few edge pixels.
+    double outer = m_radius + m_thickness / 2.0;
+    double inner = m_radius - m_thickness / 2.0;
+    int extent = static_cast<int>(std::ceil(outer + 0.5));
+
+    CoverageMask& mask = CoverageMask::scratch();
+    mask.reset(QRect(m_center.x() - extent, m_center.y() - extent, 2 * extent + 1, 2 * extent + 1),
+               fb.clipRect());
+    if (mask.isEmpty()) return;
+
+    const QRect& clip = mask.bounds();
+    for (int y = clip.top(); y <= clip.bottom(); ++y) {
+        double dy = y - m_center.y();
+        double dy2 = dy * dy;
+
+        // |dx| at which a circle of radius r crosses this row (-1 if it misses)
+        auto column = [dy2](double r) { return r > 0 && r * r > dy2 ? std::sqrt(r * r - dy2) : -1.0; };
+        double touchOuter = column(outer + 0.5);
+        if (touchOuter < 0) continue;
+        double touchInner = column(inner - 0.5);
+        double fullOuter = column(outer - 0.5);
+        double fullInner = column(inner + 0.5);
+
+        int first = touchInner < 0 ? 0 : static_cast<int>(std::floor(touchInner));
+        int last = static_cast<int>(std::ceil(touchOuter));
+        int fullFirst = fullInner < 0 ? 0 : static_cast<int>(std::ceil(fullInner));
+        int fullLast = static_cast<int>(std::floor(fullOuter));
+
+        for (int dx = first; dx <= last; ++dx) {
+            if (dx >= fullFirst && dx <= fullLast) {
+                mask.addSpan(m_center.x() + dx, m_center.x() + fullLast, y, 255);
+                mask.addSpan(m_center.x() - fullLast, m_center.x() - dx, y, 255);
+                dx = fullLast;
+                continue;
+            }
+            double d = std::sqrt(static_cast<double>(dx) * dx + dy2);
+            double coverage = std::clamp(std::min(outer + 0.5 - d, d - inner + 0.5), 0.0, 1.0);
+            int value = static_cast<int>(coverage * 255.0 + 0.5);
+            mask.add(m_center.x() + dx, y, value);
+            mask.add(m_center.x() - dx, y, value);
+        }
+    }
+    mask.composite(fb, Framebuffer::premultiply(m_color));
+}
+
+void Circle::plotPoints(CoverageMask& mask, int x, int y, int coverage)
 {
-    // Create color with alpha based on intensity
-    QColor color = m_color;
-    color.setAlphaF(intensity);
-    painter.setPen(QPen(color, 1));
-    
     // Plot all eight octants
-    painter.drawPoint(m_center.x() + x, m_center.y() + y);
-    painter.drawPoint(m_center.x() - x, m_center.y() + y);
-    painter.drawPoint(m_center.x() + x, m_center.y() - y);
-    painter.drawPoint(m_center.x() - x, m_center.y() - y);
-    painter.drawPoint(m_center.x() + y, m_center.y() + x);
-    painter.drawPoint(m_center.x() - y, m_center.y() + x);
-    painter.drawPoint(m_center.x() + y, m_center.y() - x);
-    painter.drawPoint(m_center.x() - y, m_center.y() - x);
+    mask.add(m_center.x() + x, m_center.y() + y, coverage);
+    mask.add(m_center.x() - x, m_center.y() + y, coverage);
+    mask.add(m_center.x() + x, m_center.y() - y, coverage);
+    mask.add(m_center.x() - x, m_center.y() - y, coverage);
+    mask.add(m_center.x() + y, m_center.y() + x, coverage);
+    mask.add(m_center.x() - y, m_center.y() + x, coverage);
+    mask.add(m_center.x() + y, m_center.y() - x, coverage);
+    mask.add(m_center.x() - y, m_center.y() - x, coverage);
 }
 
-void Circle::drawCenter(QPainter& painter)
+void Circle::drawCenter(Framebuffer& fb, QRgb color) const
 {
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::black);
-    painter.drawRect(m_center.x() - CENTER_SIZE/2,
-                    m_center.y() - CENTER_SIZE/2,
-                    CENTER_SIZE, CENTER_SIZE);
+    fb.fillRect(QRect(m_center.x() - CENTER_SIZE/2,
+                      m_center.y() - CENTER_SIZE/2,
+                      CENTER_SIZE + 1, CENTER_SIZE + 1),
+                color);
 }
 
-void Circle::drawRadiusPoint(QPainter& painter)
+void Circle::drawRadiusPoint(Framebuffer& fb, QRgb color) const
 {
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::black);
     QPoint radiusPoint = m_center + QPoint(m_radius, 0);
-    painter.drawRect(radiusPoint.x() - RADIUS_POINT_SIZE/2,
-                    radiusPoint.y() - RADIUS_POINT_SIZE/2,
-                    RADIUS_POINT_SIZE, RADIUS_POINT_SIZE);
+    fb.fillRect(QRect(radiusPoint.x() - RADIUS_POINT_SIZE/2,
+                      radiusPoint.y() - RADIUS_POINT_SIZE/2,
+                      RADIUS_POINT_SIZE + 1, RADIUS_POINT_SIZE + 1),
+                color);
 }
 
 bool Circle::contains(const QPoint& point) const
 {
-    int dx = point.x() - m_center.x();
-    int dy = point.y() - m_center.y();
-    int distanceSquared = dx * dx + dy * dy;
-    int radiusSquared = m_radius * m_radius;
+    qint64 dx = point.x() - m_center.x();
+    qint64 dy = point.y() - m_center.y();
+    qint64 distanceSquared = dx * dx + dy * dy;
+    qint64 radiusSquared = static_cast<qint64>(m_radius) * m_radius;
     
     // Check if point is within the circle with a small margin for selection
     return std::abs(distanceSquared - radiusSquared) <= 100;
 }
 
+bool Circle::encloses(const QPoint& point) const
+{
+    qint64 dx = point.x() - m_center.x();
+    qint64 dy = point.y() - m_center.y();
+    return dx * dx + dy * dy <= static_cast<qint64>(m_radius) * m_radius;
+}
+
 bool Circle::isNearCenter(const QPoint& point) const
 {
     int dx = point.x() - m_center.x();
@@ -148,7 +336,23 @@ bool Circle::isNearRadius(const QPoint& point) const
     return (dx * dx + dy * dy) <= (RADIUS_POINT_SIZE * RADIUS_POINT_SIZE);
 }
 
+QRect Circle::boundingRect() const
+{
+    // Half the outline width outside the radius, plus a pixel of anti-aliasing
+    int extent = std::max(m_radius + m_thickness / 2 + 2, CENTER_SIZE / 2 + 1);
+    extent = std::max(extent, m_radius + RADIUS_POINT_SIZE / 2 + 1);
+    return QRect(m_center.x() - extent, m_center.y() - extent, 2 * extent + 1, 2 * extent + 1);
+}
+
+QRect Circle::hitBounds() const
+{
+    // contains() accepts |d^2 - r^2| <= 100, so at most 10 pixels past the
+    // radius; a thick outline drawn by drawPick() can reach further
+    int extent = std::max({ m_radius + 10, m_radius + m_thickness / 2 + 1, m_radius + RADIUS_POINT_SIZE, CENTER_SIZE });
+    return QRect(m_center.x() - extent, m_center.y() - extent, 2 * extent + 1, 2 * extent + 1);
+}
+
 void Circle::move(const QPoint& offset)
 {
-    m_center += offset;
+    translate(offset);
 } 
\ No newline at end of file
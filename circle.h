@@ -1,41 +1,86 @@
 #ifndef CIRCLE_H
 #define CIRCLE_H
 
-#include <QPainter>
 #include <QColor>
 #include <QPoint>
+#include <algorithm>
+#include "framebuffer.h"
+#include "coveragemask.h"
+#include "shapesprite.h"
 
 class Circle {
 public:
     Circle(const QPoint& center, int radius);
     
-    void draw(QPainter& painter);
+    void draw(Framebuffer& fb);
+    // draw() in two steps for TileRenderer (see ShapeSprite::prepare())
+    void prepareDraw(const Framebuffer& fb);
+    void paint(Framebuffer& fb);
     bool contains(const QPoint& point) const;
     void move(const QPoint& offset);
     void setCenter(const QPoint& center) { m_center = center; }
-    void setRadius(int radius) { m_radius = radius; }
+    void setRadius(int radius) { m_radius = radius; ++m_version; }
     QPoint getCenter() const { return m_center; }
     int getRadius() const { return m_radius; }
     bool isNearCenter(const QPoint& point) const;
     bool isNearRadius(const QPoint& point) const;
     
-    void setColor(const QColor& color) { m_color = color; }
+    void setColor(const QColor& color) { m_color = color; ++m_version; }
     QColor getColor() const { return m_color; }
 
-    void setAntiAliasing(bool enabled) { m_antiAliasing = enabled; }
+    void setAntiAliasing(bool enabled) { m_antiAliasing = enabled; ++m_version; }
     bool isAntiAliasing() const { return m_antiAliasing; }
+
+    // Outline width, drawn as an annulus centered on the radius
+    void setThickness(int thickness) { m_thickness = std::max(1, thickness); ++m_version; }
+    int getThickness() const { return m_thickness; }
+
+    // Solid fill of the disc inside the outline
+    void setFilled(bool filled) { m_isFilled = filled; ++m_version; }
+    bool isFilled() const { return m_isFilled; }
+    void setFillColor(const QColor& color) { m_fillColor = color; ++m_version; }
+    QColor getFillColor() const { return m_fillColor; }
+
+    // True if point lies inside the circle (not just near the outline)
+    bool encloses(const QPoint& point) const;
+
+    // Every pixel draw() can touch, handles included
+    QRect boundingRect() const;
+
+    // Every point the hit tests (contains, encloses, isNear*) can accept, and
+    // every pixel drawPick() writes, lies inside
+    QRect hitBounds() const;
+
+    // Rasterize into a PickBuffer: the parts draw() shows, the disc only when
+    // filled, with the same spans but no anti-aliasing, each in one flat
+    // color (0 skips the part)
+    void drawPick(Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles) const;
     
 private:
-    void drawMidpointCircle(QPainter& painter);
-    void drawWuCircle(QPainter& painter);
-    void drawCenter(QPainter& painter);
-    void drawRadiusPoint(QPainter& painter);
-    void plotPoints(QPainter& painter, int x, int y, float intensity);
+    friend class ShapeSprite;
+    friend class RenderThread;
+    void render(Framebuffer& fb);
+    void translate(const QPoint& offset) { m_center += offset; }
+    quint64 spriteVersion() const { return m_version; }
+    QPoint spriteAnchor() const { return m_center; }
+    void releaseSprite() { m_sprite.clear(); }
+    void drawSpans(Framebuffer& fb, QRgb fillColor, QRgb outlineColor) const; // 0 skips either
+    void fillDisc(Framebuffer& fb, QRgb color) const; // pixel centers within m_radius
+    void drawWuCircle(Framebuffer& fb);
+    void drawAntiAliasedRing(Framebuffer& fb);
+    void drawCenter(Framebuffer& fb, QRgb color) const;
+    void drawRadiusPoint(Framebuffer& fb, QRgb color) const;
+    void plotPoints(CoverageMask& mask, int x, int y, int coverage);
     
     QPoint m_center;
     int m_radius;
     QColor m_color = Qt::black;
     bool m_antiAliasing = false;
+    int m_thickness = 1;
+    bool m_isFilled = false;
+    QColor m_fillColor = Qt::yellow;
+    quint64 m_version = ShapeSprite::firstVersion(); // bumped by every edit except moving the center
+    ShapeSprite m_sprite;  // reused while the circle is only dragged
     static const int CENTER_SIZE = 8; // Size of the center point square
     static const int RADIUS_POINT_SIZE = 6; // Size of the radius point square
 };
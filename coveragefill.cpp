@@ -0,0 +1,174 @@
+#include "coveragefill.h"
+#include <algorithm>
+#include <cmath>
+
+void CoverageFill::fill(Framebuffer& fb, const QPoint* vertices, int count, Qt::FillRule rule,
+                        const FillShader& shader)
+{
+    if (count < 3) return;
+
+    int left = vertices[0].x();
+    int right = left;
+    int top = vertices[0].y();
+    int bottom = top;
+    for (int i = 1; i < count; ++i) {
+        left = std::min(left, vertices[i].x());
+        right = std::max(right, vertices[i].x());
+        top = std::min(top, vertices[i].y());
+        bottom = std::max(bottom, vertices[i].y());
+    }
+
+    // Edge pixels reach half a pixel past the vertices
+    m_bounds = QRect(QPoint(left - 1, top - 1), QPoint(right + 1, bottom + 1)).intersected(fb.clipRect());
+    if (m_bounds.isEmpty()) return;
+
+    m_stride = m_bounds.width() + 2;
+    m_cells.assign(static_cast<size_t>(m_stride) * m_bounds.height(), 0.0f);
+    m_row.resize(m_bounds.width());
+
+    // Pixel centers sit at half-integers in buffer space
+    const double originX = m_bounds.left() - 0.5;
+    const double originY = m_bounds.top() - 0.5;
+    for (int i = 0; i < count; ++i) {
+        const QPoint& p0 = vertices[i];
+        const QPoint& p1 = vertices[(i + 1) % count];
+        addClippedEdge(p0.x() - originX, p0.y() - originY, p1.x() - originX, p1.y() - originY);
+    }
+
+    // Prefix sum per row gives each pixel's accumulated winding
+    for (int row = 0; row < m_bounds.height(); ++row) {
+        const float* cells = m_cells.data() + static_cast<size_t>(row) * m_stride;
+        float winding = 0.0f;
+        for (int x = 0; x < m_bounds.width(); ++x) {
+            winding += cells[x];
+            float coverage = std::fabs(winding);
+            if (rule == Qt::OddEvenFill) {
+                coverage = std::fmod(coverage, 2.0f);
+                if (coverage > 1.0f) coverage = 2.0f - coverage;
+            } else {
+                coverage = std::min(coverage, 1.0f);
+            }
+            m_row[x] = static_cast<quint8>(coverage * 255.0f + 0.5f);
+        }
+        const int y = m_bounds.top() + row;
+        if (shader.type() == FillShader::Solid) {
+            fb.blendCoverageSpan(m_bounds.left(), y, m_row.data(), m_bounds.width(), shader.color());
+            continue;
+        }
+
+        // Scale the shaded row by coverage; uncovered pixels become
+        // transparent and are skipped by blendSpan
+        m_shaded.resize(m_bounds.width());
+        shader.shade(m_bounds.left(), y, m_bounds.width(), m_shaded.data());
+        for (int x = 0; x < m_bounds.width(); ++x) {
+            uint coverage = m_row[x];
+            if (coverage < 255) {
+                m_shaded[x] = coverage ? Framebuffer::byteMul(m_shaded[x], coverage) : 0;
+            }
+        }
+        fb.blendSpan(m_bounds.left(), y, m_shaded.data(), m_bounds.width());
+    }
+}
+
+void CoverageFill::addClippedEdge(double x0, double y0, double x1, double y1)
+{
+    // Parts of the edge left of the buffer still change the winding of
+    // everything to their right, so they are projected onto x = 0 rather than
+    // dropped; parts past the right edge are projected onto x = width, where
+    // they land in the spare column
+    const double limits[2] = { 0.0, static_cast<double>(m_bounds.width()) };
+    double xs[4] = { x0, 0.0, 0.0, x1 };
+    double ys[4] = { y0, 0.0, 0.0, y1 };
+    int points = 1;
+    for (double limit : limits) {
+        if ((x0 < limit) != (x1 < limit) && x0 != x1) {
+            double t = (limit - x0) / (x1 - x0);
+            xs[points] = limit;
+            ys[points] = y0 + t * (y1 - y0);
+            ++points;
+        }
+    }
+    xs[points] = x1;
+    ys[points] = y1;
+    ++points;
+
+    // The crossings were found left to right; order them along the edge
+    if (points == 4 && x0 > x1) {
+        std::swap(xs[1], xs[2]);
+        std::swap(ys[1], ys[2]);
+    }
+
+    for (int i = 0; i + 1 < points; ++i) {
+        double xa = std::clamp(xs[i], limits[0], limits[1]);
+        double xb = std::clamp(xs[i + 1], limits[0], limits[1]);
+        addEdge(xa, ys[i], xb, ys[i + 1]);
+    }
+}
+
+void CoverageFill::addEdge(double x0, double y0, double x1, double y1)
+{
+    if (y0 == y1) return;
+
+    // Edges going down add positive winding, edges going up negative
+    double direction = 1.0;
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        direction = -1.0;
+    }
+
+    const double dxdy = (x1 - x0) / (y1 - y0);
+    int firstRow = std::max(0, static_cast<int>(std::floor(y0)));
+    int lastRow = std::min(m_bounds.height(), static_cast<int>(std::ceil(y1)));
+    for (int row = firstRow; row < lastRow; ++row) {
+        // The part of the edge inside this row
+        double rowTop = std::max<double>(row, y0);
+        double rowBottom = std::min<double>(row + 1, y1);
+        double d = (rowBottom - rowTop) * direction;
+        double xa = x0 + (rowTop - y0) * dxdy;
+        double xb = x0 + (rowBottom - y0) * dxdy;
+        double xMin = std::min(xa, xb);
+        double xMax = std::max(xa, xb);
+
+        float* cells = m_cells.data() + static_cast<size_t>(row) * m_stride;
+        int column = static_cast<int>(std::floor(xMin));
+        int end = static_cast<int>(std::ceil(xMax));
+
+        if (end <= column + 1) {
+            // Inside one cell: the part right of the edge's mean x is covered
+            double mid = 0.5 * (xa + xb) - column;
+            cells[column] += static_cast<float>(d * (1.0 - mid));
+            cells[column + 1] += static_cast<float>(d * mid);
+            continue;
+        }
+
+        // Spread across several cells: the swept area grows linearly with x
+        // between xMin and xMax, so the first and last cells get triangles
+        // and the cells between equal slices
+        double slope = 1.0 / (xMax - xMin);
+        double firstFraction = xMin - column;
+        double firstArea = 0.5 * slope * (1.0 - firstFraction) * (1.0 - firstFraction);
+        double lastFraction = xMax - end + 1;
+        double lastArea = 0.5 * slope * lastFraction * lastFraction;
+
+        cells[column] += static_cast<float>(d * firstArea);
+        if (end == column + 2) {
+            cells[column + 1] += static_cast<float>(d * (1.0 - firstArea - lastArea));
+        } else {
+            double secondArea = slope * (1.5 - firstFraction);
+            cells[column + 1] += static_cast<float>(d * (secondArea - firstArea));
+            for (int x = column + 2; x < end - 1; ++x) {
+                cells[x] += static_cast<float>(d * slope);
+            }
+            double beforeLast = secondArea + (end - column - 3) * slope;
+            cells[end - 1] += static_cast<float>(d * (1.0 - beforeLast - lastArea));
+        }
+        cells[end] += static_cast<float>(d * lastArea);
+    }
+}
+
+CoverageFill& CoverageFill::scratch()
+{
+    thread_local CoverageFill filler;
+    return filler;
+}
@@ -0,0 +1,38 @@
+#ifndef COVERAGEFILL_H
+#define COVERAGEFILL_H
+
+#include <QPoint>
+#include <QRect>
+#include <QtGlobal>
+#include <vector>
+#include "fillshader.h"
+#include "framebuffer.h"
+
+// Anti-aliased polygon filler using a signed-area accumulation buffer, the
+// way font rasterizers do it. Every edge adds, to each cell it crosses, the
+// signed area it sweeps to the cell's right; a prefix sum along each row then
+// yields the exact (fractional) winding number of every pixel, which the
+// fill rule turns into coverage. Cost is O(edge length + pixels).
+class CoverageFill {
+public:
+    // Blend the interior of the closed polygon into fb. Pixel (x, y) is the
+    // unit square centered on (x, y), matching the aliased scanline fill.
+    // Gradient and pattern shaders are evaluated only for covered rows.
+    void fill(Framebuffer& fb, const QPoint* vertices, int count, Qt::FillRule rule, const FillShader& shader);
+
+    // Per-thread scratch filler so fills reuse one accumulation buffer
+    static CoverageFill& scratch();
+
+private:
+    // Accumulate one edge given in buffer coordinates (pixel x covers [x, x + 1])
+    void addEdge(double x0, double y0, double x1, double y1);
+    void addClippedEdge(double x0, double y0, double x1, double y1);
+
+    QRect m_bounds;
+    int m_stride = 0; // bounds width plus room for contributions past the right edge
+    std::vector<float> m_cells;
+    std::vector<quint8> m_row;
+    std::vector<QRgb> m_shaded; // shader output for the current row
+};
+
+#endif // COVERAGEFILL_H
@@ -0,0 +1,49 @@
+#include "coveragemask.h"
+#include <algorithm>
+#include <cstring>
+
+void CoverageMask::reset(const QRect& bounds, const QRect& clip)
+{
+    m_bounds = bounds.intersected(clip);
+    if (m_bounds.isEmpty()) return;
+
+    m_coverage.assign(static_cast<size_t>(m_bounds.width()) * m_bounds.height(), 0);
+    m_rowMin.assign(m_bounds.height(), m_bounds.width());
+    m_rowMax.assign(m_bounds.height(), -1);
+}
+
+void CoverageMask::addSpan(int x0, int x1, int y, int coverage)
+{
+    if (coverage <= 0 || y < m_bounds.top() || y > m_bounds.bottom()) return;
+    x0 = std::max(x0, m_bounds.left()) - m_bounds.left();
+    x1 = std::min(x1, m_bounds.right()) - m_bounds.left();
+    if (x1 < x0) return;
+
+    int row = y - m_bounds.top();
+    quint8* values = m_coverage.data() + static_cast<size_t>(row) * m_bounds.width();
+    if (coverage >= 255) {
+        std::memset(values + x0, 255, x1 - x0 + 1);
+    } else {
+        for (int x = x0; x <= x1; ++x) {
+            values[x] = static_cast<quint8>(std::max<int>(values[x], coverage));
+        }
+    }
+    touch(row, x0, x1);
+}
+
+void CoverageMask::composite(Framebuffer& fb, QRgb color) const
+{
+    for (int row = 0; row < m_bounds.height(); ++row) {
+        int x0 = m_rowMin[row];
+        int x1 = m_rowMax[row];
+        if (x1 < x0) continue;
+        const quint8* values = m_coverage.data() + static_cast<size_t>(row) * m_bounds.width();
+        fb.blendCoverageSpan(m_bounds.left() + x0, m_bounds.top() + row, values + x0, x1 - x0 + 1, color);
+    }
+}
+
+CoverageMask& CoverageMask::scratch()
+{
+    thread_local CoverageMask mask;
+    return mask;
+}
@@ -0,0 +1,58 @@
+#ifndef COVERAGEMASK_H
+#define COVERAGEMASK_H
+
+#include <QRect>
+#include <QtGlobal>
+#include <algorithm>
+#include <vector>
+#include "framebuffer.h"
+
+// 8-bit coverage buffer for anti-aliased strokes.
+// Rasterizers record per-pixel coverage over the stroke's bounding box
+// (overlapping writes keep the maximum), then the whole buffer is blended
+// into the framebuffer in one pass with the vectorized coverage kernel.
+class CoverageMask {
+public:
+    // Clear the mask to cover bounds, clipped to clip
+    void reset(const QRect& bounds, const QRect& clip);
+    bool isEmpty() const { return m_bounds.isEmpty(); }
+    const QRect& bounds() const { return m_bounds; }
+
+    // Raise the coverage of one pixel (framebuffer coordinates)
+    void add(int x, int y, int coverage);
+
+    // Raise the coverage of the inclusive run [x0, x1] on row y
+    void addSpan(int x0, int x1, int y, int coverage);
+
+    // Blend every touched run into the framebuffer
+    void composite(Framebuffer& fb, QRgb color) const;
+
+    // Per-thread scratch mask so strokes reuse one allocation
+    static CoverageMask& scratch();
+
+private:
+    void touch(int row, int x0, int x1);
+
+    QRect m_bounds;
+    std::vector<quint8> m_coverage;
+    std::vector<int> m_rowMin; // touched column range per row (mask-local)
+    std::vector<int> m_rowMax;
+};
+
+inline void CoverageMask::add(int x, int y, int coverage)
+{
+    if (coverage <= 0 || !m_bounds.contains(x, y)) return;
+    int row = y - m_bounds.top();
+    int col = x - m_bounds.left();
+    quint8& value = m_coverage[static_cast<size_t>(row) * m_bounds.width() + col];
+    value = static_cast<quint8>(std::max<int>(value, std::min(coverage, 255)));
+    touch(row, col, col);
+}
+
+inline void CoverageMask::touch(int row, int x0, int x1)
+{
+    m_rowMin[row] = std::min(m_rowMin[row], x0);
+    m_rowMax[row] = std::max(m_rowMax[row], x1);
+}
+
+#endif // COVERAGEMASK_H
@@ -0,0 +1,158 @@
+#include "edgegrid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Call visit(cell) for every cell (row-major index) the segment [a, b] passes
+// through. Per row of cells, the columns are those between the segment's x
+// where it enters and leaves the row, so long diagonals list few cells
+template <class Visit>
+void forEachCell(const QPoint& a, const QPoint& b, const QRect& bounds, int shift, int columns, Visit visit)
+{
+    const int size = 1 << shift;
+    const int top = std::min(a.y(), b.y());
+    const int bottom = std::max(a.y(), b.y());
+    for (int row = (top - bounds.top()) >> shift; row <= (bottom - bounds.top()) >> shift; ++row) {
+        int xMin = std::min(a.x(), b.x());
+        int xMax = std::max(a.x(), b.x());
+        if (a.y() != b.y()) {
+            // Part of the segment with y inside the row (borders included)
+            double rowTop = bounds.top() + static_cast<double>(row) * size;
+            double y0 = std::max<double>(top, rowTop);
+            double y1 = std::min<double>(bottom, rowTop + size);
+            double slope = static_cast<double>(b.x() - a.x()) / (b.y() - a.y());
+            double x0 = a.x() + slope * (y0 - a.y());
+            double x1 = a.x() + slope * (y1 - a.y());
+            xMin = std::max(xMin, static_cast<int>(std::floor(std::min(x0, x1))));
+            xMax = std::min(xMax, static_cast<int>(std::ceil(std::max(x0, x1))));
+        }
+        for (int column = (xMin - bounds.left()) >> shift; column <= (xMax - bounds.left()) >> shift; ++column) {
+            visit(row * columns + column);
+        }
+    }
+}
+
+} // namespace
+
+void EdgeGrid::build(const std::vector<QPoint>& vertices, bool closed)
+{
+    clear();
+    const int count = static_cast<int>(vertices.size());
+    const int edgeCount = closed ? count : count - 1;
+    if (count < 2) return;
+
+    int minX = vertices[0].x(), maxX = minX;
+    int minY = vertices[0].y(), maxY = minY;
+    for (const QPoint& vertex : vertices) {
+        minX = std::min(minX, vertex.x());
+        maxX = std::max(maxX, vertex.x());
+        minY = std::min(minY, vertex.y());
+        maxY = std::max(maxY, vertex.y());
+    }
+    m_bounds = QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+
+    // About one cell per edge
+    m_cellShift = MinCellShift;
+    auto cells = [this](int shift) {
+        return static_cast<qint64>(((m_bounds.width() - 1) >> shift) + 1) * (((m_bounds.height() - 1) >> shift) + 1);
+    };
+    while (m_cellShift < 30 && cells(m_cellShift) > edgeCount) {
+        ++m_cellShift;
+    }
+    m_columns = column(m_bounds.right()) + 1;
+    m_rows = row(m_bounds.bottom()) + 1;
+
+    // Counting sort of (cell, edge) pairs: count, prefix-sum, scatter
+    m_cellStart.assign(static_cast<size_t>(m_columns) * m_rows + 1, 0);
+    for (int i = 0; i < edgeCount; ++i) {
+        forEachCell(vertices[i], vertices[(i + 1) % count], m_bounds, m_cellShift, m_columns,
+                    [this](int cell) { ++m_cellStart[cell + 1]; });
+    }
+    for (size_t cell = 1; cell < m_cellStart.size(); ++cell) {
+        m_cellStart[cell] += m_cellStart[cell - 1];
+    }
+    m_edges.resize(m_cellStart.back());
+    std::vector<int> next(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (int i = 0; i < edgeCount; ++i) {
+        forEachCell(vertices[i], vertices[(i + 1) % count], m_bounds, m_cellShift, m_columns,
+                    [this, &next, i](int cell) { m_edges[next[cell]++] = i; });
+    }
+
+    const QPoint origin = m_bounds.topLeft();
+    m_segments.reserve(static_cast<int>(m_edges.size()));
+    for (int edge : m_edges) {
+        m_segments.add(vertices[edge] - origin, vertices[(edge + 1) % count] - origin);
+    }
+}
+
+void EdgeGrid::clear()
+{
+    m_bounds = QRect();
+    m_columns = 0;
+    m_rows = 0;
+    m_cellStart.clear();
+    m_edges.clear();
+    m_segments.clear();
+}
+
+template <class Visit>
+void EdgeGrid::forEachEdge(const QRect& area, Visit visit) const
+{
+    if (m_columns == 0) return;
+    const QRect overlap = area.intersected(m_bounds);
+    if (overlap.isEmpty()) return;
+    for (int r = row(overlap.top()); r <= row(overlap.bottom()); ++r) {
+        for (int c = column(overlap.left()); c <= column(overlap.right()); ++c) {
+            const int cell = r * m_columns + c;
+            for (int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) {
+                visit(m_edges[i]);
+            }
+        }
+    }
+}
+
+int EdgeGrid::nearestEdge(const QPoint& point, int radius) const
+{
+    if (m_columns == 0) return -1;
+    const QRect overlap = QRect(point.x() - radius, point.y() - radius, 2 * radius + 1, 2 * radius + 1)
+                              .intersected(m_bounds);
+    if (overlap.isEmpty()) return -1;
+
+    const float x = static_cast<float>(point.x() - m_bounds.left());
+    const float y = static_cast<float>(point.y() - m_bounds.top());
+    const float limit = static_cast<float>(radius) * radius;
+    int nearest = -1;
+    float nearestDistance = 0;
+    for (int r = row(overlap.top()); r <= row(overlap.bottom()); ++r) {
+        for (int c = column(overlap.left()); c <= column(overlap.right()); ++c) {
+            const int cell = r * m_columns + c;
+            float distance;
+            int i = m_segments.nearest(x, y, m_cellStart[cell], m_cellStart[cell + 1], limit, distance);
+            if (i < 0) continue;
+            const int edge = m_edges[i];
+            if (nearest < 0 || distance < nearestDistance || (distance == nearestDistance && edge < nearest)) {
+                nearest = edge;
+                nearestDistance = distance;
+            }
+        }
+    }
+    return nearest;
+}
+
+int EdgeGrid::firstVertex(const std::vector<QPoint>& vertices, const QPoint& point, int radius) const
+{
+    // Every vertex is an end of some edge, which is listed in the vertex's cell
+    const int count = static_cast<int>(vertices.size());
+    int first = -1;
+    forEachEdge(QRect(point.x() - radius, point.y() - radius, 2 * radius + 1, 2 * radius + 1), [&](int edge) {
+        for (int vertex : { edge, (edge + 1) % count }) {
+            int dx = point.x() - vertices[vertex].x();
+            int dy = point.y() - vertices[vertex].y();
+            if (dx * dx + dy * dy <= radius * radius && (first < 0 || vertex < first)) {
+                first = vertex;
+            }
+        }
+    });
+    return first;
+}
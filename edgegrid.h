@@ -0,0 +1,54 @@
+#ifndef EDGEGRID_H
+#define EDGEGRID_H
+
+#include <QPoint>
+#include <QRect>
+#include <vector>
+#include "segmentbuffer.h"
+
+// Uniform grid over the edges of one polyline, for proximity queries.
+// Cells are a power of two in size, chosen so there are about as many cells
+// as edges, and each lists the edges passing through it (cell offsets plus
+// one flat index array). A query near a point only measures the edges of
+// the few cells around it, so it costs the same for 10 or 100 000 vertices.
+//
+// Each cell's edges are also kept as one contiguous run of a SegmentBuffer,
+// relative to the grid origin, so nearestEdge() measures a cell's edges in
+// SIMD batches and translate() only has to move the origin. firstVertex()
+// takes the vertices the grid was built from.
+class EdgeGrid {
+public:
+    // Index the edges of vertices; a closed polyline also has the edge from
+    // the last vertex back to the first
+    void build(const std::vector<QPoint>& vertices, bool closed);
+    void clear();
+    void translate(const QPoint& offset) { m_bounds.translate(offset); }
+
+    // Edge nearest to point within radius (lowest index on ties), or -1.
+    // Edge i runs from vertex i to the next one
+    int nearestEdge(const QPoint& point, int radius) const;
+
+    // Lowest-index vertex within radius of point, or -1
+    int firstVertex(const std::vector<QPoint>& vertices, const QPoint& point, int radius) const;
+
+private:
+    static constexpr int MinCellShift = 3; // 8 px cells at the finest
+
+    // Call visit(edge) for each entry of every cell overlapping area; an edge
+    // spanning several of those cells is visited once per cell
+    template <class Visit>
+    void forEachEdge(const QRect& area, Visit visit) const;
+
+    int column(int x) const { return (x - m_bounds.left()) >> m_cellShift; }
+    int row(int y) const { return (y - m_bounds.top()) >> m_cellShift; }
+
+    QRect m_bounds; // vertex bounds; cell (0, 0) starts at its top-left
+    int m_cellShift = MinCellShift;
+    int m_columns = 0;
+    int m_rows = 0;
+    std::vector<int> m_cellStart; // edges of cell c are m_edges[m_cellStart[c] .. m_cellStart[c + 1])
+    std::vector<int> m_edges;
+    SegmentBuffer m_segments; // m_segments[i] is edge m_edges[i], relative to m_bounds.topLeft()
+};
+
+#endif // EDGEGRID_H
@@ -0,0 +1,316 @@
+#include "fillshader.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define FILLSHADER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define FILLSHADER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace {
+
+// Ramp index of a gradient position, padded to [0, 1]
+inline int rampIndex(float t)
+{
+    return static_cast<int>(std::min(std::max(t * 255.0f + 0.5f, 0.0f), 255.0f));
+}
+
+// ---- Linear: t = base + x * step ----
+
+void linearScalar(QRgb* out, const QRgb* ramp, int x, int count, float base, float step)
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = ramp[rampIndex(base + static_cast<float>(x + i) * step)];
+    }
+}
+
+// ---- Radial: t = sqrt((x - cx)^2 + dy^2) * scale ----
+
+void radialScalar(QRgb* out, const QRgb* ramp, int x, int count, float cx, float dy2, float scale)
+{
+    for (int i = 0; i < count; ++i) {
+        float dx = static_cast<float>(x + i) - cx;
+        out[i] = ramp[rampIndex(std::sqrt(dx * dx + dy2) * scale)];
+    }
+}
+
+#ifdef FILLSHADER_SSE2
+inline __m128i rampIndicesSse2(__m128 t)
+{
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 v = _mm_add_ps(_mm_mul_ps(t, scale), half);
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), scale);
+    return _mm_cvttps_epi32(v);
+}
+
+inline void lookupSse2(QRgb* out, const QRgb* ramp, __m128i indices)
+{
+    alignas(16) int index[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(index), indices);
+    out[0] = ramp[index[0]];
+    out[1] = ramp[index[1]];
+    out[2] = ramp[index[2]];
+    out[3] = ramp[index[3]];
+}
+
+inline __m128 columnsSse2(int x)
+{
+    return _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3)));
+}
+
+void linearSse2(QRgb* out, const QRgb* ramp, int x, int count, float base, float step)
+{
+    const __m128 b = _mm_set1_ps(base);
+    const __m128 s = _mm_set1_ps(step);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 t = _mm_add_ps(b, _mm_mul_ps(columnsSse2(x + i), s));
+        lookupSse2(out + i, ramp, rampIndicesSse2(t));
+    }
+    linearScalar(out + i, ramp, x + i, count - i, base, step);
+}
+
+void radialSse2(QRgb* out, const QRgb* ramp, int x, int count, float cx, float dy2, float scale)
+{
+    const __m128 c = _mm_set1_ps(cx);
+    const __m128 d = _mm_set1_ps(dy2);
+    const __m128 s = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(columnsSse2(x + i), c);
+        __m128 t = _mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), d)), s);
+        lookupSse2(out + i, ramp, rampIndicesSse2(t));
+    }
+    radialScalar(out + i, ramp, x + i, count - i, cx, dy2, scale);
+}
+#endif
+
+#ifdef FILLSHADER_AVX2
+__attribute__((target("avx2")))
+inline __m256i rampLookupAvx2(const QRgb* ramp, __m256 t)
+{
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    __m256 v = _mm256_add_ps(_mm256_mul_ps(t, scale), _mm256_set1_ps(0.5f));
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), scale);
+    return _mm256_i32gather_epi32(reinterpret_cast<const int*>(ramp), _mm256_cvttps_epi32(v), 4);
+}
+
+__attribute__((target("avx2")))
+inline __m256 columnsAvx2(int x)
+{
+    return _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+__attribute__((target("avx2")))
+void linearAvx2(QRgb* out, const QRgb* ramp, int x, int count, float base, float step)
+{
+    const __m256 b = _mm256_set1_ps(base);
+    const __m256 s = _mm256_set1_ps(step);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 t = _mm256_add_ps(b, _mm256_mul_ps(columnsAvx2(x + i), s));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), rampLookupAvx2(ramp, t));
+    }
+    linearScalar(out + i, ramp, x + i, count - i, base, step);
+}
+
+__attribute__((target("avx2")))
+void radialAvx2(QRgb* out, const QRgb* ramp, int x, int count, float cx, float dy2, float scale)
+{
+    const __m256 c = _mm256_set1_ps(cx);
+    const __m256 d = _mm256_set1_ps(dy2);
+    const __m256 s = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 dx = _mm256_sub_ps(columnsAvx2(x + i), c);
+        __m256 t = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), d)), s);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), rampLookupAvx2(ramp, t));
+    }
+    radialScalar(out + i, ramp, x + i, count - i, cx, dy2, scale);
+}
+#endif
+
+using GradientFunction = void (*)(QRgb*, const QRgb*, int, int, float, float);
+
+GradientFunction selectLinear()
+{
+#ifdef FILLSHADER_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return linearAvx2;
+    }
+#endif
+#ifdef FILLSHADER_SSE2
+    return linearSse2;
+#else
+    return linearScalar;
+#endif
+}
+
+using RadialFunction = void (*)(QRgb*, const QRgb*, int, int, float, float, float);
+
+RadialFunction selectRadial()
+{
+#ifdef FILLSHADER_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return radialAvx2;
+    }
+#endif
+#ifdef FILLSHADER_SSE2
+    return radialSse2;
+#else
+    return radialScalar;
+#endif
+}
+
+// One 8x8 hatch tile, bit x of row y set where the pattern is drawn
+std::array<quint8, 8> hatchTile(Qt::BrushStyle style)
+{
+    std::array<quint8, 8> rows{};
+    for (int y = 0; y < 8; ++y) {
+        quint8 horizontal = y == 0 ? 0xff : 0x00;
+        quint8 vertical = 0x01;
+        quint8 forward = static_cast<quint8>(1u << y);       // '\'
+        quint8 backward = static_cast<quint8>(0x80u >> y);   // '/'
+        switch (style) {
+        case Qt::HorPattern: rows[y] = horizontal; break;
+        case Qt::VerPattern: rows[y] = vertical; break;
+        case Qt::CrossPattern: rows[y] = horizontal | vertical; break;
+        case Qt::FDiagPattern: rows[y] = forward; break;
+        case Qt::BDiagPattern: rows[y] = backward; break;
+        case Qt::DiagCrossPattern: rows[y] = forward | backward; break;
+        default: rows[y] = 0xff; break;
+        }
+    }
+    return rows;
+}
+
+} // namespace
+
+FillShader::FillShader(Type type, const QColor& color0, const QColor& color1)
+    : m_type(type), m_color0(color0), m_color1(color1)
+{
+}
+
+FillShader FillShader::solid(const QColor& color)
+{
+    FillShader shader(Solid, color, color);
+    shader.m_ramp[0] = Framebuffer::premultiply(color);
+    return shader;
+}
+
+FillShader FillShader::linear(const QPoint& start, const QPoint& end, const QColor& color0, const QColor& color1)
+{
+    FillShader shader(LinearGradient, color0, color1);
+    shader.m_start = start;
+    shader.m_end = end;
+    shader.buildRamp();
+    shader.updateGeometry();
+    return shader;
+}
+
+FillShader FillShader::radial(const QPoint& center, int radius, const QColor& color0, const QColor& color1)
+{
+    FillShader shader(RadialGradient, color0, color1);
+    shader.m_start = center;
+    shader.m_end = center + QPoint(std::max(1, radius), 0);
+    shader.buildRamp();
+    shader.updateGeometry();
+    return shader;
+}
+
+FillShader FillShader::hatch(Qt::BrushStyle style, const QColor& color0, const QColor& color1)
+{
+    FillShader shader(Hatch, color0, color1);
+    shader.m_hatchStyle = style;
+    shader.buildHatch();
+    return shader;
+}
+
+void FillShader::buildRamp()
+{
+    // Interpolate straight colors, then premultiply (QGradient's default)
+    for (int i = 0; i < 256; ++i) {
+        auto mix = [i](int a, int b) { return (a * (255 - i) + b * i + 127) / 255; };
+        QColor color(mix(m_color0.red(), m_color1.red()), mix(m_color0.green(), m_color1.green()),
+                     mix(m_color0.blue(), m_color1.blue()), mix(m_color0.alpha(), m_color1.alpha()));
+        m_ramp[i] = Framebuffer::premultiply(color);
+    }
+}
+
+void FillShader::buildHatch()
+{
+    const QRgb foreground = Framebuffer::premultiply(m_color0);
+    const QRgb background = Framebuffer::premultiply(m_color1);
+    const std::array<quint8, 8> tile = hatchTile(m_hatchStyle);
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            m_hatchRows[y * 16 + x] = (tile[y] >> (x & 7)) & 1 ? foreground : background;
+        }
+    }
+}
+
+void FillShader::updateGeometry()
+{
+    float dx = static_cast<float>(m_end.x() - m_start.x());
+    float dy = static_cast<float>(m_end.y() - m_start.y());
+    float lengthSquared = dx * dx + dy * dy;
+    if (m_type == LinearGradient) {
+        // A degenerate gradient paints color0 everywhere
+        m_stepX = lengthSquared > 0.0f ? dx / lengthSquared : 0.0f;
+        m_stepY = lengthSquared > 0.0f ? dy / lengthSquared : 0.0f;
+    } else if (m_type == RadialGradient) {
+        m_stepX = 1.0f / std::sqrt(lengthSquared);
+        m_stepY = 0.0f;
+    }
+}
+
+void FillShader::translate(const QPoint& offset)
+{
+    m_start += offset;
+    m_end += offset;
+}
+
+void FillShader::shade(int x, int y, int count, QRgb* out) const
+{
+    switch (m_type) {
+    case Solid:
+        std::fill(out, out + count, m_ramp[0]);
+        break;
+    case LinearGradient: {
+        static const GradientFunction linear = selectLinear();
+        // Columns relative to start, so a translated gradient rounds the same
+        float base = static_cast<float>(y - m_start.y()) * m_stepY;
+        linear(out, m_ramp.data(), x - m_start.x(), count, base, m_stepX);
+        break;
+    }
+    case RadialGradient: {
+        static const RadialFunction radial = selectRadial();
+        float dy = static_cast<float>(y - m_start.y());
+        radial(out, m_ramp.data(), x, count, static_cast<float>(m_start.x()), dy * dy, m_stepX);
+        break;
+    }
+    case Hatch: {
+        // Copy from the doubled pattern row, four pixels per step
+        const QRgb* row = m_hatchRows.data() + ((y - m_start.y()) & 7) * 16;
+        int phase = (x - m_start.x()) & 7;
+        int i = 0;
+#ifdef FILLSHADER_SSE2
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + phase)));
+            phase = (phase + 4) & 7;
+        }
+#endif
+        for (; i < count; ++i) {
+            out[i] = row[phase];
+            phase = (phase + 1) & 7;
+        }
+        break;
+    }
+    }
+}
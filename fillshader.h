@@ -0,0 +1,72 @@
+#ifndef FILLSHADER_H
+#define FILLSHADER_H
+
+#include <QColor>
+#include <QPoint>
+#include <array>
+#include "framebuffer.h"
+
+// Per-span color source for polygon fills.
+// A shader turns one horizontal run of pixels into premultiplied colors in a
+// single call, so the scanline and anti-aliased fillers can paint solid
+// colors, gradients and hatch patterns through the same span pipeline.
+// Gradients are read from a 256-entry color ramp built once per shader and
+// the run generators are vectorized (AVX2/SSE2) where available.
+class FillShader {
+public:
+    enum Type {
+        Solid,
+        LinearGradient,
+        RadialGradient,
+        Hatch
+    };
+
+    FillShader() : FillShader(solid(Qt::yellow)) {}
+
+    static FillShader solid(const QColor& color);
+    // Gradient from color0 at start to color1 at end, padded past both ends
+    static FillShader linear(const QPoint& start, const QPoint& end, const QColor& color0, const QColor& color1);
+    // Gradient from color0 at center to color1 at distance radius
+    static FillShader radial(const QPoint& center, int radius, const QColor& color0, const QColor& color1);
+    // 8x8 pattern in color0 over color1 (Hor/Ver/Cross/BDiag/FDiag/DiagCross),
+    // tiled from start(), initially (0, 0)
+    static FillShader hatch(Qt::BrushStyle style, const QColor& color0, const QColor& color1 = Qt::transparent);
+
+    Type type() const { return m_type; }
+    QColor color0() const { return m_color0; }
+    QColor color1() const { return m_color1; }
+    QPoint start() const { return m_start; }         // gradient start, center or hatch origin
+    QPoint end() const { return m_end; }             // gradient end or a point on the radius
+    Qt::BrushStyle hatchStyle() const { return m_hatchStyle; }
+    QRgb color() const { return m_ramp[0]; }         // premultiplied solid color
+
+    // Keep the gradient or hatch attached to a shape that moved
+    void translate(const QPoint& offset);
+
+    // Write the premultiplied colors of pixels (x .. x + count - 1, y) to out
+    void shade(int x, int y, int count, QRgb* out) const;
+
+private:
+    FillShader(Type type, const QColor& color0, const QColor& color1);
+
+    void buildRamp();
+    void buildHatch();
+    void updateGeometry();
+
+    Type m_type;
+    QColor m_color0;
+    QColor m_color1;
+    QPoint m_start;
+    QPoint m_end;
+    Qt::BrushStyle m_hatchStyle = Qt::NoBrush;
+
+    // Linear: t = (x - start) . (end - start) / |end - start|^2
+    // Radial: t = |(x, y) - center| / radius
+    float m_stepX = 0.0f;
+    float m_stepY = 0.0f;
+
+    std::array<QRgb, 256> m_ramp;         // color at t = i / 255 (solid: entry 0)
+    std::array<QRgb, 8 * 16> m_hatchRows; // each pattern row repeated twice
+};
+
+#endif // FILLSHADER_H
@@ -0,0 +1,272 @@
+#include "framebuffer.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define FRAMEBUFFER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define FRAMEBUFFER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace {
+
+// Premultiplied source-over of color * coverage[i] onto dst[i]
+void blendCoverageScalar(QRgb* dst, const quint8* coverage, int count, QRgb color)
+{
+    for (int i = 0; i < count; ++i) {
+        uint c = coverage[i];
+        if (c == 0) continue;
+        dst[i] = Framebuffer::sourceOver(dst[i], c == 255 ? color : Framebuffer::byteMul(color, c));
+    }
+}
+
+#ifdef FRAMEBUFFER_SSE2
+// Per 16-bit channel: (a * b + 127.5) / 255 rounded the same way as byteMul
+inline __m128i mul255(__m128i a, __m128i b)
+{
+    __m128i t = _mm_mullo_epi16(a, b);
+    t = _mm_add_epi16(t, _mm_srli_epi16(t, 8));
+    t = _mm_add_epi16(t, _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(t, 8);
+}
+
+// Blend two pixels held as 16-bit channels
+inline __m128i blendPair(__m128i dst, __m128i src, __m128i coverage)
+{
+    const __m128i full = _mm_set1_epi16(0xff);
+    src = mul255(src, coverage);
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_add_epi16(src, mul255(dst, _mm_sub_epi16(full, alpha)));
+}
+
+void blendCoverageSse2(QRgb* dst, const quint8* coverage, int count, QRgb color)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int packed;
+        std::memcpy(&packed, coverage + i, 4);
+        if (packed == 0) continue;
+
+        // Replicate each coverage byte across its pixel's four channels
+        __m128i c = _mm_cvtsi32_si128(packed);
+        c = _mm_unpacklo_epi8(c, c);
+        c = _mm_unpacklo_epi16(c, c);
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = blendPair(_mm_unpacklo_epi8(d, zero), src, _mm_unpacklo_epi8(c, zero));
+        __m128i hi = blendPair(_mm_unpackhi_epi8(d, zero), src, _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blendCoverageScalar(dst + i, coverage + i, count - i, color);
+}
+#endif
+
+// Premultiplied source-over of a row of source pixels
+void blendSourceScalar(QRgb* dst, const QRgb* src, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = Framebuffer::sourceOver(dst[i], src[i]);
+    }
+}
+
+#ifdef FRAMEBUFFER_SSE2
+void blendSourceSse2(QRgb* dst, const QRgb* src, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+    const __m128i full = _mm_set1_epi16(0xff);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i alpha = _mm_and_si128(s, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff) continue;
+
+        // dst * (255 - alpha) + src, two pixels per 16-bit half
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i sLo = _mm_unpacklo_epi8(s, zero);
+        __m128i sHi = _mm_unpackhi_epi8(s, zero);
+        __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i lo = _mm_add_epi16(sLo, mul255(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, aLo)));
+        __m128i hi = _mm_add_epi16(sHi, mul255(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, aHi)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blendSourceScalar(dst + i, src + i, count - i);
+}
+#endif
+
+#ifdef FRAMEBUFFER_AVX2
+__attribute__((target("avx2")))
+inline __m256i mul255Avx2(__m256i a, __m256i b)
+{
+    __m256i t = _mm256_mullo_epi16(a, b);
+    t = _mm256_add_epi16(t, _mm256_srli_epi16(t, 8));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(0x80));
+    return _mm256_srli_epi16(t, 8);
+}
+
+__attribute__((target("avx2")))
+inline __m256i blendPairAvx2(__m256i dst, __m256i src, __m256i coverage)
+{
+    const __m256i full = _mm256_set1_epi16(0xff);
+    src = mul255Avx2(src, coverage);
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_add_epi16(src, mul255Avx2(dst, _mm256_sub_epi16(full, alpha)));
+}
+
+__attribute__((target("avx2")))
+void blendCoverageAvx2(QRgb* dst, const quint8* coverage, int count, QRgb color)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i src = _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(color)), zero);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        long long packed;
+        std::memcpy(&packed, coverage + i, 8);
+        if (packed == 0) continue;
+
+        // One coverage value per 32-bit lane, replicated into all four bytes
+        __m256i c = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(packed));
+        c = _mm256_mullo_epi32(c, _mm256_set1_epi32(0x01010101));
+
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i lo = blendPairAvx2(_mm256_unpacklo_epi8(d, zero), src, _mm256_unpacklo_epi8(c, zero));
+        __m256i hi = blendPairAvx2(_mm256_unpackhi_epi8(d, zero), src, _mm256_unpackhi_epi8(c, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+#ifdef FRAMEBUFFER_SSE2
+    blendCoverageSse2(dst + i, coverage + i, count - i, color);
+#else
+    blendCoverageScalar(dst + i, coverage + i, count - i, color);
+#endif
+}
+#endif
+
+using BlendCoverageFunction = void (*)(QRgb*, const quint8*, int, QRgb);
+
+BlendCoverageFunction selectBlendCoverage()
+{
+#ifdef FRAMEBUFFER_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return blendCoverageAvx2;
+    }
+#endif
+#ifdef FRAMEBUFFER_SSE2
+    return blendCoverageSse2;
+#else
+    return blendCoverageScalar;
+#endif
+}
+
+} // namespace
+
+void Framebuffer::resize(const QSize& size)
+{
+    if (m_image.size() == size) return;
+    m_image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    m_clip = m_image.rect();
+}
+
+void Framebuffer::setClipRect(const QRect& rect)
+{
+    m_clip = rect.isNull() ? m_image.rect() : rect.intersected(m_image.rect());
+}
+
+Framebuffer Framebuffer::view()
+{
+    // A QImage over foreign memory never copies it: the view's image is its
+    // only reference, so writes through it never detach. constBits() keeps
+    // this safe to call from several threads once this image is detached.
+    detach();
+    Framebuffer view;
+    view.m_image = QImage(const_cast<uchar*>(m_image.constBits()), width(), height(), m_image.bytesPerLine(),
+                          m_image.format());
+    view.m_clip = m_clip;
+    return view;
+}
+
+void Framebuffer::clear(const QColor& color)
+{
+    m_image.fill(premultiply(color));
+}
+
+void Framebuffer::fillSpan(int x0, int x1, int y, QRgb color)
+{
+    if (y < m_clip.top() || y > m_clip.bottom()) return;
+    x0 = std::max(x0, m_clip.left());
+    x1 = std::min(x1, m_clip.right());
+    if (x1 < x0) return;
+
+    QRgb* dst = scanLine(y) + x0;
+    int count = x1 - x0 + 1;
+    if (qAlpha(color) == 255) {
+        std::fill(dst, dst + count, color);
+        return;
+    }
+    uint inverseAlpha = 255 - qAlpha(color);
+    for (int i = 0; i < count; ++i) {
+        dst[i] = color + byteMul(dst[i], inverseAlpha);
+    }
+}
+
+void Framebuffer::fillRect(const QRect& rect, QRgb color)
+{
+    QRect clipped = rect.intersected(m_clip);
+    for (int y = clipped.top(); y <= clipped.bottom(); ++y) {
+        fillSpan(clipped.left(), clipped.right(), y, color);
+    }
+}
+
+void Framebuffer::copyFrom(const Framebuffer& source, const QRect& rect)
+{
+    QRect clipped = rect.intersected(m_clip).intersected(source.m_image.rect());
+    if (clipped.isEmpty()) return;
+    for (int y = clipped.top(); y <= clipped.bottom(); ++y) {
+        const QRgb* src = reinterpret_cast<const QRgb*>(source.m_image.constScanLine(y)) + clipped.left();
+        std::memcpy(scanLine(y) + clipped.left(), src, clipped.width() * sizeof(QRgb));
+    }
+}
+
+void Framebuffer::blendCoverageSpan(int x, int y, const quint8* coverage, int count, QRgb color)
+{
+    if (y < m_clip.top() || y > m_clip.bottom()) return;
+    if (x < m_clip.left()) {
+        int skip = m_clip.left() - x;
+        coverage += skip;
+        count -= skip;
+        x = m_clip.left();
+    }
+    count = std::min(count, m_clip.right() + 1 - x);
+    if (count <= 0) return;
+
+    static const BlendCoverageFunction blend = selectBlendCoverage();
+    blend(scanLine(y) + x, coverage, count, color);
+}
+
+void Framebuffer::blendSpan(int x, int y, const QRgb* src, int count)
+{
+    if (y < m_clip.top() || y > m_clip.bottom()) return;
+    if (x < m_clip.left()) {
+        int skip = m_clip.left() - x;
+        src += skip;
+        count -= skip;
+        x = m_clip.left();
+    }
+    count = std::min(count, m_clip.right() + 1 - x);
+    if (count <= 0) return;
+
+#ifdef FRAMEBUFFER_SSE2
+    blendSourceSse2(scanLine(y) + x, src, count);
+#else
+    blendSourceScalar(scanLine(y) + x, src, count);
+#endif
+}
@@ -0,0 +1,115 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <QImage>
+#include <QColor>
+#include <QRect>
+#include <QSize>
+#include <QtGlobal>
+
+// Software raster target owned by the canvas.
+// Shapes write pixels and horizontal spans straight into a persistent
+// ARGB32_Premultiplied image instead of issuing one QPainter call per pixel;
+// the canvas then blits the whole image once per paint event.
+class Framebuffer {
+public:
+    Framebuffer() = default;
+
+    // Reallocate the backing image if the size changed (resets the clip)
+    void resize(const QSize& size);
+    void clear(const QColor& color);
+
+    // Restrict every write below to rect (a null rect means the whole image),
+    // so a partial repaint leaves pixels outside the damaged area untouched
+    void setClipRect(const QRect& rect);
+    QRect clipRect() const { return m_clip; }
+
+    // A second framebuffer writing straight into this one's pixels, with a
+    // clip of its own; threads rendering disjoint clips each take a view.
+    // The view must not outlive this framebuffer or a resize() of it.
+    Framebuffer view();
+
+    QImage& image() { return m_image; }
+    const QImage& image() const { return m_image; }
+    int width() const { return m_image.width(); }
+    int height() const { return m_image.height(); }
+
+    // All colors below are premultiplied ARGB (see premultiply())
+    static QRgb premultiply(const QColor& color) { return qPremultiply(color.rgba()); }
+
+    // Source-over a single pixel; coverage scales the color (0..255)
+    void plot(int x, int y, QRgb color);
+    void blendPixel(int x, int y, QRgb color, int coverage);
+
+    // Source-over the inclusive run [x0, x1] on row y
+    void fillSpan(int x0, int x1, int y, QRgb color);
+
+    // Source-over a rectangle (clipped to the clip rect)
+    void fillRect(const QRect& rect, QRgb color);
+
+    // Replace the pixels of rect (clipped) with the same pixels of source
+    void copyFrom(const Framebuffer& source, const QRect& rect);
+
+    // Source-over count pixels starting at (x, y), each with color scaled by
+    // its own 8-bit coverage value; vectorized (AVX2/SSE2) where available
+    void blendCoverageSpan(int x, int y, const quint8* coverage, int count, QRgb color);
+
+    // Source-over count premultiplied source pixels starting at (x, y);
+    // opaque runs are copied, transparent ones skipped
+    void blendSpan(int x, int y, const QRgb* src, int count);
+
+    // Give the image its own pixels before several threads write to it
+    // (each to different rows); row writes then never touch shared state
+    void detach();
+
+    // Multiply all four premultiplied channels by a (0..255)
+    static inline QRgb byteMul(QRgb x, uint a)
+    {
+        uint t = (x & 0xff00ff) * a;
+        t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+        t &= 0xff00ff;
+        x = ((x >> 8) & 0xff00ff) * a;
+        x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+        x &= 0xff00ff00;
+        return x | t;
+    }
+
+    static inline QRgb sourceOver(QRgb dst, QRgb src)
+    {
+        uint alpha = qAlpha(src);
+        if (alpha == 255) return src;
+        return src + byteMul(dst, 255 - alpha);
+    }
+
+private:
+    // Unlike QImage::scanLine() this does not bump QImage's detach counter
+    // on every call, so concurrent writers to distinct rows do not race
+    QRgb* scanLine(int y)
+    {
+        detach();
+        return reinterpret_cast<QRgb*>(const_cast<uchar*>(m_image.constScanLine(y)));
+    }
+
+    QImage m_image;
+    QRect m_clip; // always inside the image
+};
+
+inline void Framebuffer::detach()
+{
+    if (!m_image.isDetached()) m_image.detach();
+}
+
+inline void Framebuffer::plot(int x, int y, QRgb color)
+{
+    if (!m_clip.contains(x, y)) return;
+    QRgb& dst = scanLine(y)[x];
+    dst = sourceOver(dst, color);
+}
+
+inline void Framebuffer::blendPixel(int x, int y, QRgb color, int coverage)
+{
+    if (coverage <= 0) return;
+    plot(x, y, coverage >= 255 ? color : byteMul(color, coverage));
+}
+
+#endif // FRAMEBUFFER_H
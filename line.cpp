@@ -1,11 +1,12 @@
 #include "line.h"
-#include <QPainter>
+#include "segmentbuffer.h"
+#include "stroke.h"
 #include <cmath>
 #include <algorithm>
 #include <QDebug>
 
 Line::Line(const QPoint& start, const QPoint& end)
-    : m_start(start), m_end(end), m_brush(1)
+    : m_start(start), m_end(end)
 {
     qDebug() << "Line created from" << start << "to" << end;
 }
@@ -13,188 +14,62 @@ Line::Line(const QPoint& start, const QPoint& end)
 void Line::setThickness(int thickness)
 {
     m_thickness = std::max(1, thickness);
-    m_brush = Brush(m_thickness);
+    m_brush = &Brush::forSize(m_thickness);
+    ++m_version;
 }
 
-void Line::draw(QPainter& painter)
+void Line::draw(Framebuffer& fb)
 {
-    if (m_brush.isAntiAliasing()) {
-        drawWuLine(painter);
-    } else {
-        painter.setPen(QPen(m_color, 1)); // Use 1-pixel pen for brush drawing
-        drawDDA(painter);
-    }
-    drawEndpoints(painter);
+    m_sprite.draw(fb, *this);
 }
 
-void Line::drawDDA(QPainter& painter)
+void Line::prepareDraw(const Framebuffer&)
 {
-    int x1 = m_start.x();
-    int y1 = m_start.y();
-    int x2 = m_end.x();
-    int y2 = m_end.y();
-    
-    qDebug() << "Drawing DDA line from" << m_start << "to" << m_end;
-    
-    // Calculate dx and dy
-    int dx = x2 - x1;
-    int dy = y2 - y1;
-    
-    // Calculate steps required for generating pixels
-    int steps = std::max(abs(dx), abs(dy));
-    
-    // Calculate increment in x and y for each step
-    float xIncrement = dx / (float)steps;
-    float yIncrement = dy / (float)steps;
-    
-    // Put pixel for each step
-    float x = x1;
-    float y = y1;
-    
-    for (int i = 0; i <= steps; i++) {
-        drawWithBrush(painter, round(x), round(y));
-        x += xIncrement;
-        y += yIncrement;
-    }
+    m_sprite.prepare(*this);
 }
 
-void Line::drawWithBrush(QPainter& painter, int x, int y)
+void Line::paint(Framebuffer& fb)
 {
-    const auto& pattern = m_brush.getPattern();
-    int size = m_brush.getSize();
-    int halfSize = size / 2;
-    
-    // Draw the brush pattern around the center point
-    for (int dy = 0; dy < size; ++dy) {
-        for (int dx = 0; dx < size; ++dx) {
-            if (pattern[dy][dx]) {
-                painter.drawPoint(x + dx - halfSize, y + dy - halfSize);
-            }
-        }
-    }
+    m_sprite.paint(fb, *this);
 }
 
-void Line::drawWuLine(QPainter& painter)
+void Line::render(Framebuffer& fb)
 {
-    int x1 = m_start.x();
-    int y1 = m_start.y();
-    int x2 = m_end.x();
-    int y2 = m_end.y();
-
-    // Calculate differences
-    int dx = x2 - x1;
-    int dy = y2 - y1;
-
-    // Handle vertical lines
-    if (dx == 0) {
-        int y = std::min(y1, y2);
-        int yEnd = std::max(y1, y2);
-        while (y <= yEnd) {
-            painter.setPen(QPen(m_color, 1));
-            painter.drawPoint(x1, y);
-            y++;
-        }
-        return;
-    }
-
-    // Handle horizontal lines
-    if (dy == 0) {
-        int x = std::min(x1, x2);
-        int xEnd = std::max(x1, x2);
-        while (x <= xEnd) {
-            painter.setPen(QPen(m_color, 1));
-            painter.drawPoint(x, y1);
-            x++;
-        }
-        return;
-    }
-
-    // Determine if the line is steep
-    bool steep = std::abs(dy) > std::abs(dx);
-    
-    // If steep, swap x and y coordinates
-    if (steep) {
-        std::swap(x1, y1);
-        std::swap(x2, y2);
-        std::swap(dx, dy);
-    }
-
-    // Ensure we're always drawing from left to right
-    if (x1 > x2) {
-        std::swap(x1, x2);
-        std::swap(y1, y2);
-        dx = -dx;
-        dy = -dy;
-    }
-
-    float gradient = static_cast<float>(dy) / dx;
-    float y = y1;
-
-    // Main loop
-    for (int x = x1; x <= x2; x++) {
-        // Calculate the two y values
-        int yFloor = static_cast<int>(y);
-        int yCeil = yFloor + 1;
-        float intensity = y - yFloor;
-
-        // Draw the two pixels
-        QColor color1 = m_color;
-        QColor color2 = m_color;
-        color1.setAlphaF(1.0f - intensity);
-        color2.setAlphaF(intensity);
-
-        if (steep) {
-            // For steep lines, swap back x and y coordinates when drawing
-            painter.setPen(QPen(color1, 1));
-            painter.drawPoint(yFloor, x);
-            painter.setPen(QPen(color2, 1));
-            painter.drawPoint(yCeil, x);
-        } else {
-            painter.setPen(QPen(color1, 1));
-            painter.drawPoint(x, yFloor);
-            painter.setPen(QPen(color2, 1));
-            painter.drawPoint(x, yCeil);
-        }
+    QPoint points[] = { m_start, m_end };
+    strokePolyline(fb, points, 2, false, *m_brush, m_antiAliasing, Framebuffer::premultiply(m_color));
+    drawEndpoints(fb, Framebuffer::premultiply(Qt::black));
+}
 
-        y += gradient;
+void Line::drawPick(Framebuffer& fb, QRgb, QRgb outline, QRgb handles) const
+{
+    if (outline) {
+        QPoint points[] = { m_start, m_end };
+        strokePolyline(fb, points, 2, false, *m_brush, false, outline);
     }
+    if (handles) drawEndpoints(fb, handles);
 }
 
-void Line::drawEndpoints(QPainter& painter)
+void Line::drawEndpoints(Framebuffer& fb, QRgb color) const
 {
-    // Draw black squares at endpoints
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::black);
+    // Draw squares at endpoints (outline + fill, like QPainter::drawRect)
     
     // Draw start point square
-    painter.drawRect(m_start.x() - ENDPOINT_SIZE/2, 
-                    m_start.y() - ENDPOINT_SIZE/2,
-                    ENDPOINT_SIZE, ENDPOINT_SIZE);
+    fb.fillRect(QRect(m_start.x() - ENDPOINT_SIZE/2,
+                      m_start.y() - ENDPOINT_SIZE/2,
+                      ENDPOINT_SIZE + 1, ENDPOINT_SIZE + 1), color);
     
     // Draw end point square
-    painter.drawRect(m_end.x() - ENDPOINT_SIZE/2,
-                    m_end.y() - ENDPOINT_SIZE/2,
-                    ENDPOINT_SIZE, ENDPOINT_SIZE);
+    fb.fillRect(QRect(m_end.x() - ENDPOINT_SIZE/2,
+                      m_end.y() - ENDPOINT_SIZE/2,
+                      ENDPOINT_SIZE + 1, ENDPOINT_SIZE + 1), color);
 }
 
 bool Line::contains(const QPoint& point) const
 {
-    // Calculate the distance from the point to the line
-    int x = point.x();
-    int y = point.y();
-    int x1 = m_start.x();
-    int y1 = m_start.y();
-    int x2 = m_end.x();
-    int y2 = m_end.y();
-    
-    // Calculate the line length
-    float lineLength = sqrt(pow(x2 - x1, 2) + pow(y2 - y1, 2));
-    
-    // Calculate the distance from the point to the line
-    float distance = abs((y2 - y1) * x - (x2 - x1) * y + x2 * y1 - y2 * x1) / lineLength;
-    
-    // Check if the point is within a certain threshold of the line
-    return distance <= m_thickness; // Use thickness as threshold
+    // Distance to the segment itself, not to the line through it; a
+    // zero-length line measures to its one point
+    const float threshold = static_cast<float>(m_thickness) * m_thickness;
+    return SegmentBuffer::distanceSquared(point, m_start, m_end) <= threshold;
 }
 
 bool Line::isNearEndpoint(const QPoint& point, bool& isStart) const
@@ -224,7 +99,26 @@ bool Line::isNearEndpoint(const QPoint& point, bool& isStart) const
 }
 
 void Line::move(const QPoint& offset)
+{
+    translate(offset);
+}
+
+void Line::translate(const QPoint& offset)
 {
     m_start += offset;
     m_end += offset;
+}
+
+QRect Line::boundingRect() const
+{
+    // Brush radius (plus a pixel of anti-aliasing) or the handle, whichever is larger
+    int margin = std::max(m_thickness / 2 + 2, ENDPOINT_SIZE / 2 + 1);
+    return QRect(m_start, m_end).normalized().adjusted(-margin, -margin, margin, margin);
+}
+
+QRect Line::hitBounds() const
+{
+    // Within the thickness of the segment, or ENDPOINT_SIZE of an endpoint
+    int margin = std::max(m_thickness, ENDPOINT_SIZE);
+    return QRect(m_start, m_end).normalized().adjusted(-margin, -margin, margin, margin);
 }
\ No newline at end of file
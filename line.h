@@ -1,44 +1,66 @@
 #ifndef LINE_H
 #define LINE_H
 
-#include <QPainter>
 #include <QColor>
 #include <QPoint>
 #include "brush.h"
+#include "framebuffer.h"
+#include "shapesprite.h"
 
 class Line {
 public:
     Line(const QPoint& start, const QPoint& end);
     
-    void draw(QPainter& painter);
+    void draw(Framebuffer& fb);
+    // draw() in two steps for TileRenderer (see ShapeSprite::prepare())
+    void prepareDraw(const Framebuffer& fb);
+    void paint(Framebuffer& fb);
     bool contains(const QPoint& point) const;
     void move(const QPoint& offset);
     QPoint getStartPoint() const { return m_start; }
     QPoint getEndPoint() const { return m_end; }
-    void setStartPoint(const QPoint& point) { m_start = point; }
-    void setEndPoint(const QPoint& point) { m_end = point; }
+    void setStartPoint(const QPoint& point) { m_start = point; ++m_version; }
+    void setEndPoint(const QPoint& point) { m_end = point; ++m_version; }
     bool isNearEndpoint(const QPoint& point, bool& isStart) const;
     
-    void setColor(const QColor& color) { m_color = color; }
+    void setColor(const QColor& color) { m_color = color; ++m_version; }
     QColor getColor() const { return m_color; }
     
     void setThickness(int thickness);
     int getThickness() const { return m_thickness; }
 
-    void setAntiAliasing(bool enabled) { m_brush.setAntiAliasing(enabled); }
-    bool isAntiAliasing() const { return m_brush.isAntiAliasing(); }
+    void setAntiAliasing(bool enabled) { m_antiAliasing = enabled; ++m_version; }
+    bool isAntiAliasing() const { return m_antiAliasing; }
+
+    // Every pixel draw() can touch, endpoint handles included
+    QRect boundingRect() const;
+
+    // Every point contains() or isNearEndpoint() can accept, and every pixel
+    // drawPick() writes, lies inside
+    QRect hitBounds() const;
+
+    // Rasterize into a PickBuffer: the parts draw() shows, with the same
+    // brush but no anti-aliasing, each in one flat color (0 skips the part)
+    void drawPick(Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles) const;
     
 private:
-    void drawDDA(QPainter& painter);
-    void drawEndpoints(QPainter& painter);
-    void drawWithBrush(QPainter& painter, int x, int y);
-    void drawWuLine(QPainter& painter);
+    friend class ShapeSprite;
+    friend class RenderThread;
+    void render(Framebuffer& fb);
+    void translate(const QPoint& offset);
+    quint64 spriteVersion() const { return m_version; }
+    QPoint spriteAnchor() const { return m_start; }
+    void releaseSprite() { m_sprite.clear(); }
+    void drawEndpoints(Framebuffer& fb, QRgb color) const;
     
     QPoint m_start;
     QPoint m_end;
     QColor m_color = Qt::black;
     int m_thickness = 1;
-    Brush m_brush;
+    const Brush* m_brush = &Brush::forSize(1); // shared, see Brush::forSize
+    bool m_antiAliasing = false;
+    quint64 m_version = ShapeSprite::firstVersion(); // bumped by every edit except translation
+    ShapeSprite m_sprite;  // reused while the line is only dragged
     static const int ENDPOINT_SIZE = 8; // Size of the endpoint squares
 };
 
@@ -0,0 +1,216 @@
+#include "linebatch.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LINEBATCH_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LINEBATCH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace LineBatch {
+
+namespace {
+
+long long floorDiv(long long a, long long b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// First i in [lo, hi] where pred(i) holds, for pred false then true over the
+// range; hi + 1 if it never holds
+template <class Pred>
+long long firstWhere(long long lo, long long hi, Pred pred)
+{
+    while (lo <= hi) {
+        long long mid = lo + (hi - lo) / 2;
+        if (pred(mid)) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+} // namespace
+
+bool Segment::clip(const QRect& area)
+{
+    const int majorMin = steep ? area.top() : area.left();
+    const int majorMax = steep ? area.bottom() : area.right();
+    const int minorMin = steep ? area.left() : area.top();
+    const int minorMax = steep ? area.right() : area.bottom();
+    if (length == 0) {
+        return major >= majorMin && major <= majorMax && minor >= minorMin && minor <= minorMax;
+    }
+
+    // Steps inside the major range
+    long long first = majorStep > 0 ? static_cast<long long>(majorMin) - major : static_cast<long long>(major) - majorMax;
+    long long last = majorStep > 0 ? static_cast<long long>(majorMax) - major : static_cast<long long>(major) - majorMin;
+    first = std::max(first, 0LL);
+    last = std::min<long long>(last, steps);
+    if (first > last) return false;
+
+    // The stepper keeps error in [0, 2 * length), so step i is at minor
+    // + floor((error + 2 * i * delta) / (2 * length)), monotonic in i
+    const long long twoLength = 2LL * length;
+    auto offset = [&](long long i) { return floorDiv(error + 2 * i * delta, twoLength); };
+    auto minorAt = [&](long long i) { return minor + offset(i); };
+    if (delta >= 0) {
+        first = firstWhere(first, last, [&](long long i) { return minorAt(i) >= minorMin; });
+        last = firstWhere(first, last, [&](long long i) { return minorAt(i) > minorMax; }) - 1;
+    } else {
+        first = firstWhere(first, last, [&](long long i) { return minorAt(i) <= minorMax; });
+        last = firstWhere(first, last, [&](long long i) { return minorAt(i) < minorMin; }) - 1;
+    }
+    if (first > last) return false;
+
+    const long long carried = offset(first);
+    error = static_cast<int32_t>(error + 2 * first * delta - carried * twoLength);
+    major += static_cast<int32_t>(first * majorStep);
+    minor += static_cast<int32_t>(carried);
+    steps = static_cast<int32_t>(last - first);
+    return true;
+}
+
+void Group::load(const Segment* segments, int count)
+{
+    maxSteps = 0;
+    for (int lane = 0; lane < Lanes; ++lane) {
+        if (lane < count) {
+            const Segment& s = segments[lane];
+            major[lane] = s.major;
+            minor[lane] = s.minor;
+            majorStep[lane] = s.majorStep;
+            error[lane] = s.error;
+            twoDelta[lane] = 2 * s.delta;
+            twoSteps[lane] = 2 * s.length;
+            steepMask[lane] = s.steep ? -1 : 0;
+            steps[lane] = s.steps;
+            maxSteps = std::max(maxSteps, s.steps);
+        } else {
+            // Unused lanes step harmlessly and are never read back
+            major[lane] = minor[lane] = majorStep[lane] = 0;
+            error[lane] = twoDelta[lane] = steepMask[lane] = 0;
+            twoSteps[lane] = 1;
+            steps[lane] = -1;
+        }
+    }
+}
+
+namespace {
+
+#ifndef LINEBATCH_SSE2
+void stepGroupScalar(const Group& g, int32_t* xs, int32_t* ys)
+{
+    for (int lane = 0; lane < Lanes; ++lane) {
+        int32_t major = g.major[lane];
+        int32_t minor = g.minor[lane];
+        int32_t error = g.error[lane];
+        for (int i = 0; i <= g.maxSteps; ++i) {
+            int index = i * Lanes + lane;
+            xs[index] = g.steepMask[lane] ? minor : major;
+            ys[index] = g.steepMask[lane] ? major : minor;
+            major += g.majorStep[lane];
+            error += g.twoDelta[lane];
+            int carry = (error >= g.twoSteps[lane]) - (error < 0);
+            minor += carry;
+            error -= carry * g.twoSteps[lane];
+        }
+    }
+}
+#endif
+
+#ifdef LINEBATCH_SSE2
+// Two 4-lane halves per group; selects use and/andnot since blendv is SSE4.1
+void stepGroupSse2(const Group& g, int32_t* xs, int32_t* ys)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    for (int half = 0; half < Lanes; half += 4) {
+        __m128i major = _mm_load_si128(reinterpret_cast<const __m128i*>(g.major + half));
+        __m128i minor = _mm_load_si128(reinterpret_cast<const __m128i*>(g.minor + half));
+        __m128i majorStep = _mm_load_si128(reinterpret_cast<const __m128i*>(g.majorStep + half));
+        __m128i error = _mm_load_si128(reinterpret_cast<const __m128i*>(g.error + half));
+        __m128i twoDelta = _mm_load_si128(reinterpret_cast<const __m128i*>(g.twoDelta + half));
+        __m128i twoSteps = _mm_load_si128(reinterpret_cast<const __m128i*>(g.twoSteps + half));
+        __m128i steep = _mm_load_si128(reinterpret_cast<const __m128i*>(g.steepMask + half));
+        __m128i twoStepsMinusOne = _mm_sub_epi32(twoSteps, one);
+
+        for (int i = 0; i <= g.maxSteps; ++i) {
+            __m128i x = _mm_or_si128(_mm_and_si128(steep, minor), _mm_andnot_si128(steep, major));
+            __m128i y = _mm_or_si128(_mm_and_si128(steep, major), _mm_andnot_si128(steep, minor));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(xs + i * Lanes + half), x);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ys + i * Lanes + half), y);
+
+            major = _mm_add_epi32(major, majorStep);
+            error = _mm_add_epi32(error, twoDelta);
+            __m128i up = _mm_cmpgt_epi32(error, twoStepsMinusOne); // error >= twoSteps
+            __m128i down = _mm_cmpgt_epi32(zero, error);           // error < 0
+            minor = _mm_add_epi32(_mm_sub_epi32(minor, up), down);
+            error = _mm_add_epi32(_mm_sub_epi32(error, _mm_and_si128(up, twoSteps)),
+                                  _mm_and_si128(down, twoSteps));
+        }
+    }
+}
+#endif
+
+#ifdef LINEBATCH_AVX2
+__attribute__((target("avx2")))
+void stepGroupAvx2(const Group& g, int32_t* xs, int32_t* ys)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i major = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.major));
+    __m256i minor = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.minor));
+    __m256i majorStep = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.majorStep));
+    __m256i error = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.error));
+    __m256i twoDelta = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.twoDelta));
+    __m256i twoSteps = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.twoSteps));
+    __m256i steep = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.steepMask));
+    __m256i twoStepsMinusOne = _mm256_sub_epi32(twoSteps, _mm256_set1_epi32(1));
+
+    for (int i = 0; i <= g.maxSteps; ++i) {
+        __m256i x = _mm256_blendv_epi8(major, minor, steep);
+        __m256i y = _mm256_blendv_epi8(minor, major, steep);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(xs + i * Lanes), x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ys + i * Lanes), y);
+
+        major = _mm256_add_epi32(major, majorStep);
+        error = _mm256_add_epi32(error, twoDelta);
+        __m256i up = _mm256_cmpgt_epi32(error, twoStepsMinusOne); // error >= twoSteps
+        __m256i down = _mm256_cmpgt_epi32(zero, error);           // error < 0
+        minor = _mm256_add_epi32(_mm256_sub_epi32(minor, up), down);
+        error = _mm256_add_epi32(_mm256_sub_epi32(error, _mm256_and_si256(up, twoSteps)),
+                                 _mm256_and_si256(down, twoSteps));
+    }
+}
+#endif
+
+using StepFunction = void (*)(const Group&, int32_t*, int32_t*);
+
+StepFunction selectStepFunction()
+{
+#ifdef LINEBATCH_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return stepGroupAvx2;
+    }
+#endif
+#ifdef LINEBATCH_SSE2
+    return stepGroupSse2;
+#else
+    return stepGroupScalar;
+#endif
+}
+
+} // namespace
+
+void stepGroup(const Group& group, int32_t* xs, int32_t* ys)
+{
+    static const StepFunction step = selectStepFunction();
+    step(group, xs, ys);
+}
+
+} // namespace LineBatch
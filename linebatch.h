@@ -0,0 +1,95 @@
+#ifndef LINEBATCH_H
+#define LINEBATCH_H
+
+#include <QPoint>
+#include <QRect>
+#include <cstdint>
+#include <cstdlib>
+
+// Batched integer DDA: steps Lanes line segments at once.
+// Each lane runs the same exact integer stepper as LineKernel::ddaOctant, so
+// batched and one-at-a-time output are identical. stepGroup() picks an AVX2,
+// SSE2 or scalar implementation at runtime.
+namespace LineBatch {
+
+constexpr int Lanes = 8;
+
+// Longest segment the 32-bit lanes can step exactly (2 * length must fit)
+constexpr int MaxLength = 1 << 28;
+
+// Most steps one lane takes; segments are clipped to the drawable area first,
+// so this only has to cover the largest canvas, and it bounds the xs/ys
+// buffers of stepGroup()
+constexpr int MaxSteps = 1 << 15;
+
+inline bool fits(const QPoint& start, const QPoint& end)
+{
+    long long dx = static_cast<long long>(end.x()) - start.x();
+    long long dy = static_cast<long long>(end.y()) - start.y();
+    return std::llabs(dx) <= MaxLength && std::llabs(dy) <= MaxLength;
+}
+
+// One segment in major/minor form, possibly clipped to a run of its steps:
+// the stepper starts at (major, minor) with the error term the full segment
+// has there, so a clipped run plots exactly the pixels of the full one
+struct Segment {
+    int32_t major;
+    int32_t minor;
+    int32_t majorStep; // +1 or -1
+    int32_t delta;     // minor-axis extent, |delta| <= length
+    int32_t length;    // major-axis extent of the whole segment
+    int32_t error;     // error term at the first step
+    int32_t steps;     // steps to take from (major, minor)
+    bool steep;
+
+    static Segment fromPoints(const QPoint& start, const QPoint& end)
+    {
+        int dx = end.x() - start.x();
+        int dy = end.y() - start.y();
+        Segment s;
+        s.steep = std::abs(dy) > std::abs(dx);
+        if (s.steep) {
+            s.major = start.y();
+            s.minor = start.x();
+            s.majorStep = dy > 0 ? 1 : -1;
+            s.delta = dx;
+            s.length = std::abs(dy);
+        } else {
+            s.major = start.x();
+            s.minor = start.y();
+            s.majorStep = dx > 0 ? 1 : -1;
+            s.delta = dy;
+            s.length = std::abs(dx);
+        }
+        s.error = s.length;
+        s.steps = s.length;
+        return s;
+    }
+
+    // Restrict to the steps whose pixel lies in area; false if none does
+    bool clip(const QRect& area);
+};
+
+// Structure-of-arrays stepper state for up to Lanes segments
+struct Group {
+    alignas(32) int32_t major[Lanes];
+    alignas(32) int32_t minor[Lanes];
+    alignas(32) int32_t majorStep[Lanes];
+    alignas(32) int32_t error[Lanes];
+    alignas(32) int32_t twoDelta[Lanes];
+    alignas(32) int32_t twoSteps[Lanes];
+    alignas(32) int32_t steepMask[Lanes]; // -1 for steep lanes, 0 otherwise
+    alignas(32) int32_t steps[Lanes];     // -1 for unused lanes
+    int maxSteps = 0;
+
+    void load(const Segment* segments, int count);
+};
+
+// Step every lane from 0 to maxSteps, writing lane L's i-th pixel to
+// xs[i * Lanes + L] / ys[i * Lanes + L]; both buffers need
+// (maxSteps + 1) * Lanes entries
+void stepGroup(const Group& group, int32_t* xs, int32_t* ys);
+
+} // namespace LineBatch
+
+#endif // LINEBATCH_H
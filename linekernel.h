@@ -0,0 +1,233 @@
+#ifndef LINEKERNEL_H
+#define LINEKERNEL_H
+
+#include <QPoint>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "brush.h"
+#include "coveragemask.h"
+#include "linebatch.h"
+#include "strokemask.h"
+
+// Header-only line rasterization kernels shared by every shape.
+// The kernels are templated on a pixel sink and on compile-time policies so
+// each combination (aliased / anti-aliased, 1px / brush, steep / shallow)
+// gets its own inner loop without per-pixel branches.
+namespace LineKernel {
+
+// ---- Rendering policies ----
+struct Aliased {};
+struct AntiAliased {};
+
+// ---- Brush size classes for aliased strokes ----
+struct OnePixelBrush {
+    static void plot(StrokeMask& mask, const Brush&, int x, int y) { mask.setSpan(x, x, y); }
+};
+struct DiscBrush {
+    static void plot(StrokeMask& mask, const Brush& brush, int x, int y) { mask.stamp(brush, x, y); }
+};
+
+// ---- Sinks ----
+
+// Collects aliased pixels in a coverage mask (composited once by the caller)
+template <class BrushClass>
+struct MaskSink {
+    StrokeMask& mask;
+    const Brush& brush;
+    void plot(int x, int y) { BrushClass::plot(mask, brush, x, y); }
+};
+
+// Records anti-aliased coverage (blended once by the caller)
+struct CoverageSink {
+    CoverageMask& mask;
+    void plot(int x, int y) { mask.add(x, y, 255); }
+    void blend(int x, int y, int coverage) { mask.add(x, y, coverage); }
+    void span(int x0, int x1, int y) { mask.addSpan(x0, x1, y, 255); }
+};
+
+// ---- DDA ----
+
+// One octant pair of the DDA: the major axis advances by exactly one pixel
+// per step and the minor axis is the exactly rounded position
+// minor + i * delta / steps, tracked with an integer error term instead of a
+// float accumulator (|delta| <= steps, so the carry is at most one pixel)
+template <bool Steep, class Sink>
+inline void ddaOctant(int major, int minor, int majorStep, int steps, int delta, Sink& sink)
+{
+    const long long twoSteps = 2LL * steps;
+    const long long twoDelta = 2LL * delta;
+    long long error = steps; // remainder of (2 * i * delta + steps) / (2 * steps)
+    for (int i = 0; i <= steps; ++i) {
+        if (Steep) {
+            sink.plot(minor, major);
+        } else {
+            sink.plot(major, minor);
+        }
+        major += majorStep;
+        error += twoDelta;
+        int carry = (error >= twoSteps) - (error < 0);
+        minor += carry;
+        error -= carry * twoSteps;
+    }
+}
+
+template <class Sink>
+inline void drawSegment(const QPoint& start, const QPoint& end, Aliased, Sink& sink)
+{
+    int dx = end.x() - start.x();
+    int dy = end.y() - start.y();
+
+    // A zero-length segment is a single step along either axis
+    if (std::abs(dy) > std::abs(dx)) {
+        ddaOctant<true>(start.y(), start.x(), dy > 0 ? 1 : -1, std::abs(dy), dx, sink);
+    } else {
+        ddaOctant<false>(start.x(), start.y(), dx > 0 ? 1 : -1, std::abs(dx), dy, sink);
+    }
+}
+
+// ---- Wu ----
+
+// Main Wu loop, walking the major axis left to right (x1 <= x2 after swaps)
+template <bool Steep, class Sink>
+inline void wuOctant(int x1, int y1, int x2, float gradient, Sink& sink)
+{
+    // The minor position is tracked relative to y1 and floored, so a
+    // translated line (or one partly above or left of 0) rounds the same
+    float offset = 0.0f;
+    for (int x = x1; x <= x2; ++x) {
+        int step = static_cast<int>(std::floor(offset));
+        int yFloor = y1 + step;
+        float intensity = offset - static_cast<float>(step);
+
+        // Coverage of the two pixels straddling the ideal line
+        int coverage2 = static_cast<int>(intensity * 255.0f + 0.5f);
+        int coverage1 = 255 - coverage2;
+        if (Steep) {
+            sink.blend(yFloor, x, coverage1);
+            sink.blend(yFloor + 1, x, coverage2);
+        } else {
+            sink.blend(x, yFloor, coverage1);
+            sink.blend(x, yFloor + 1, coverage2);
+        }
+        offset += gradient;
+    }
+}
+
+template <class Sink>
+inline void drawSegment(const QPoint& start, const QPoint& end, AntiAliased, Sink& sink)
+{
+    int x1 = start.x();
+    int y1 = start.y();
+    int x2 = end.x();
+    int y2 = end.y();
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+
+    // Axis-aligned lines need no blending
+    if (dx == 0) {
+        for (int y = std::min(y1, y2); y <= std::max(y1, y2); ++y) {
+            sink.plot(x1, y);
+        }
+        return;
+    }
+    if (dy == 0) {
+        sink.span(std::min(x1, x2), std::max(x1, x2), y1);
+        return;
+    }
+
+    bool steep = std::abs(dy) > std::abs(dx);
+    if (steep) {
+        std::swap(x1, y1);
+        std::swap(x2, y2);
+        std::swap(dx, dy);
+    }
+    if (x1 > x2) {
+        std::swap(x1, x2);
+        std::swap(y1, y2);
+        dx = -dx;
+        dy = -dy;
+    }
+
+    float gradient = static_cast<float>(dy) / dx;
+    if (steep) {
+        wuOctant<true>(x1, y1, x2, gradient, sink);
+    } else {
+        wuOctant<false>(x1, y1, x2, gradient, sink);
+    }
+}
+
+// ---- Polylines ----
+
+// Feed every edge of a polyline (closing it if requested) to the kernel
+template <class Policy, class Sink>
+inline void drawPolyline(const QPoint* points, int count, bool closed, Sink& sink)
+{
+    if (count < 2) return;
+    int edges = closed ? count : count - 1;
+    for (int i = 0; i < edges; ++i) {
+        drawSegment(points[i], points[(i + 1) % count], Policy(), sink);
+    }
+}
+
+// Rasterize many aliased polyline edges through the SIMD batch stepper.
+// Each edge is first clipped to the steps whose pixel lies in area, so off-
+// screen parts cost nothing and the step buffers stay within the canvas
+// size. Edges are then sorted by length and stepped LineBatch::Lanes at a
+// time, so the order in which pixels reach the sink is not the polyline
+// order: only use this with order-independent sinks such as MaskSink.
+template <class Sink>
+inline void drawPolylineBatched(const QPoint* points, int count, bool closed, const QRect& area, Sink& sink)
+{
+    if (count < 2) return;
+    int edges = closed ? count : count - 1;
+
+    thread_local std::vector<LineBatch::Segment> segments;
+    thread_local std::vector<int32_t> xs;
+    thread_local std::vector<int32_t> ys;
+
+    segments.clear();
+    for (int i = 0; i < edges; ++i) {
+        const QPoint& start = points[i];
+        const QPoint& end = points[(i + 1) % count];
+        if (!LineBatch::fits(start, end)) {
+            drawSegment(start, end, Aliased(), sink);
+            continue;
+        }
+        LineBatch::Segment segment = LineBatch::Segment::fromPoints(start, end);
+        if (!segment.clip(area)) continue;
+        if (segment.steps > LineBatch::MaxSteps) {
+            drawSegment(start, end, Aliased(), sink);
+            continue;
+        }
+        segments.push_back(segment);
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const LineBatch::Segment& a, const LineBatch::Segment& b) { return a.steps < b.steps; });
+
+    LineBatch::Group group;
+    for (size_t first = 0; first < segments.size(); first += LineBatch::Lanes) {
+        int lanes = static_cast<int>(std::min<size_t>(LineBatch::Lanes, segments.size() - first));
+        group.load(segments.data() + first, lanes);
+        size_t needed = static_cast<size_t>(group.maxSteps + 1) * LineBatch::Lanes;
+        if (xs.size() < needed) {
+            xs.resize(needed);
+            ys.resize(needed);
+        }
+        LineBatch::stepGroup(group, xs.data(), ys.data());
+
+        // Lane-major readback: lane L's i-th pixel is at [i * Lanes + L]
+        for (int lane = 0; lane < lanes; ++lane) {
+            int steps = group.steps[lane];
+            for (int i = 0; i <= steps; ++i) {
+                size_t index = static_cast<size_t>(i) * LineBatch::Lanes + lane;
+                sink.plot(xs[index], ys[index]);
+            }
+        }
+    }
+}
+
+} // namespace LineKernel
+
+#endif // LINEKERNEL_H
@@ -42,6 +42,9 @@ MainWindow::MainWindow(QWidget *parent)
     btnChangeColor = ui->btnChangeColor;
     btnThicken = ui->btnThicken;
     btnToggleAntiAliasing = ui->btnToggleAntiAliasing;
+    btnToggleFillRule = ui->btnToggleFillRule;
+    btnFillStyle = ui->btnFillStyle;
+    btnToggleSnap = ui->btnToggleSnap;
     
     // Get the file operation buttons
     btnSave = ui->btnSave;
@@ -62,6 +65,9 @@ MainWindow::MainWindow(QWidget *parent)
     connect(btnChangeColor, &QPushButton::clicked, this, &MainWindow::onChangeColor);
     connect(btnThicken, &QPushButton::clicked, this, &MainWindow::onThicken);
     connect(btnToggleAntiAliasing, &QPushButton::clicked, this, &MainWindow::onToggleAntiAliasing);
+    connect(btnToggleFillRule, &QPushButton::clicked, this, &MainWindow::onToggleFillRule);
+    connect(btnFillStyle, &QPushButton::clicked, this, &MainWindow::onFillStyle);
+    connect(btnToggleSnap, &QPushButton::clicked, this, &MainWindow::onToggleSnap);
     
     // Connect file operation signals to slots
     connect(btnSave, &QPushButton::clicked, this, &MainWindow::onSave);
@@ -179,7 +185,7 @@ void MainWindow::onFill()
     canvas->setClippingMode(false);
     canvas->setFillMode(true);
     canvas->setImageFillMode(false);
-    statusLabel->setText("Mode: Fill Polygon (Click on polygon to toggle fill)");
+    statusLabel->setText("Mode: Fill (Click on a polygon or circle to toggle fill)");
 }
 
 void MainWindow::onImageFill()
@@ -229,6 +235,31 @@ void MainWindow::onToggleAntiAliasing()
     statusLabel->setText(QString("Anti-aliasing: %1").arg(antiAliasingEnabled ? "Enabled" : "Disabled"));
 }
 
+void MainWindow::onToggleFillRule()
+{
+    static bool nonZero = false;
+    nonZero = !nonZero;
+    canvas->setFillRule(nonZero ? Qt::WindingFill : Qt::OddEvenFill);
+    statusLabel->setText(QString("Fill rule: %1").arg(nonZero ? "Non-zero" : "Even-odd"));
+}
+
+void MainWindow::onFillStyle()
+{
+    static int style = FillShader::Solid;
+    static const char* const names[] = { "Solid", "Linear gradient", "Radial gradient", "Hatch" };
+    style = (style + 1) % 4;
+    canvas->setFillStyle(static_cast<FillShader::Type>(style));
+    statusLabel->setText(QString("Fill style: %1").arg(names[style]));
+}
+
+void MainWindow::onToggleSnap()
+{
+    static bool snapEnabled = false;
+    snapEnabled = !snapEnabled;
+    canvas->setSnapMode(snapEnabled);
+    statusLabel->setText(QString("Snap to vertices: %1").arg(snapEnabled ? "Enabled" : "Disabled"));
+}
+
 // File operation slots
 void MainWindow::onSave()
 {
@@ -260,7 +291,10 @@ void MainWindow::onSave()
             << circle->getCenter().x() << " "
             << circle->getCenter().y() << " "
             << circle->getRadius() << " "
-            << circle->getColor().name() << "\n";
+            << circle->getColor().name() << " "
+            << circle->getThickness() << " "
+            << (circle->isFilled() ? "1" : "0") << " "
+            << circle->getFillColor().name() << "\n";
     }
     
     // Save rectangles
@@ -285,7 +319,14 @@ void MainWindow::onSave()
             << (polygon->isFilled() ? "1" : "0") << " "
             << polygon->getFillColor().name() << " "
             << (polygon->isImageFilled() ? "1" : "0") << " "
-            << polygon->getFillImagePath() << "\n";
+            << polygon->getFillImagePath() << " ";
+        const FillShader& shader = polygon->getFillShader();
+        out << shader.type() << " "
+            << shader.start().x() << " " << shader.start().y() << " "
+            << shader.end().x() << " " << shader.end().y() << " "
+            << shader.color1().name(QColor::HexArgb) << " "
+            << shader.hatchStyle() << " "
+            << (polygon->getFillRule() == Qt::WindingFill ? "1" : "0") << "\n";
     }
 
     file.close();
@@ -331,6 +372,14 @@ void MainWindow::onLoad()
             
             auto newCircle = std::make_unique<Circle>(center, radius);
             newCircle->setColor(color);
+            // Thickness and fill were added later; older files omit them
+            if (parts.size() >= 8) {
+                newCircle->setThickness(parts[5].toInt());
+                if (parts[6].toInt() == 1) {
+                    newCircle->setFilled(true);
+                    newCircle->setFillColor(QColor(parts[7]));
+                }
+            }
             canvas->addCircle(std::move(newCircle));
         }
         else if (parts[0] == "RECTANGLE" && parts.size() >= 7) {
@@ -373,11 +422,40 @@ void MainWindow::onLoad()
             }
             newPolygon->setColor(color);
             newPolygon->setThickness(thickness);
+            // The fill rule was added later; older files get the current one
+            if (parts.size() > i+14) {
+                newPolygon->setFillRule(parts[i+14].toInt() == 1 ? Qt::WindingFill : Qt::OddEvenFill);
+            } else {
+                newPolygon->setFillRule(canvas->fillRule());
+            }
             if (isClosed) newPolygon->close();
             if (isFilled) {
                 newPolygon->setFilled(true);
                 newPolygon->setFillColor(fillColor);
             }
+            if (parts.size() > i+13) {
+                // Fill shader: type, start, end, second color, hatch style
+                QPoint start(parts[i+8].toInt(), parts[i+9].toInt());
+                QPoint end(parts[i+10].toInt(), parts[i+11].toInt());
+                QColor color1(parts[i+12]);
+                switch (parts[i+7].toInt()) {
+                case FillShader::LinearGradient:
+                    newPolygon->setFillShader(FillShader::linear(start, end, fillColor, color1));
+                    break;
+                case FillShader::RadialGradient:
+                    newPolygon->setFillShader(FillShader::radial(start, end.x() - start.x(), fillColor, color1));
+                    break;
+                case FillShader::Hatch: {
+                    FillShader hatch = FillShader::hatch(static_cast<Qt::BrushStyle>(parts[i+13].toInt()),
+                                                         fillColor, color1);
+                    hatch.translate(start);
+                    newPolygon->setFillShader(hatch);
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
             if (isImageFilled && !imagePath.isEmpty()) {
                 QImage img(imagePath);
                 if (!img.isNull()) {
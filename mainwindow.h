@@ -38,6 +38,9 @@ private:
     QPushButton *btnChangeColor;
     QPushButton *btnThicken;
     QPushButton *btnToggleAntiAliasing;
+    QPushButton *btnToggleFillRule;
+    QPushButton *btnFillStyle;
+    QPushButton *btnToggleSnap;
     QPushButton *btnFill;
     QPushButton *btnImageFill;
     
@@ -61,6 +64,9 @@ private slots:
     void onChangeColor();
     void onThicken();
     void onToggleAntiAliasing();
+    void onToggleFillRule();
+    void onFillStyle();
+    void onToggleSnap();
     
     // File operation slots
     void onSave();
@@ -0,0 +1,118 @@
+#include "pickbuffer.h"
+#include <algorithm>
+
+void PickBuffer::invalidate(const QRect& area)
+{
+    // A resize invalidates everything anyway (see takeInvalid())
+    m_invalid |= area.isNull() ? m_buffer.image().rect() : area;
+}
+
+void PickBuffer::forget(const void* shape)
+{
+    auto found = m_ids.find(shape);
+    if (found == m_ids.end()) return;
+    m_owners[found->second].shape = nullptr;
+    m_freeIds.push_back(found->second);
+    m_ids.erase(found);
+}
+
+void PickBuffer::clear()
+{
+    m_owners.clear();
+    m_freeIds.clear();
+    m_ids.clear();
+    invalidate();
+}
+
+bool PickBuffer::idOf(Kind kind, void* shape, quint32& id)
+{
+    auto found = m_ids.find(shape);
+    if (found != m_ids.end()) {
+        id = found->second;
+        return true;
+    }
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+        m_owners[id] = Owner{ kind, shape };
+    } else if (m_owners.size() < MaxIds) {
+        id = static_cast<quint32>(m_owners.size());
+        m_owners.push_back(Owner{ kind, shape });
+    } else {
+        return false; // more shapes than IDs: the rest cannot be picked
+    }
+    m_ids.emplace(shape, id);
+    return true;
+}
+
+QRegion PickBuffer::takeInvalid(const QSize& size)
+{
+    const QRect bounds(QPoint(0, 0), size);
+    if (m_buffer.image().size() != size) {
+        m_buffer.resize(size);
+        m_invalid = bounds;
+    }
+    QRegion invalid = m_invalid.intersected(bounds);
+    m_invalid = QRegion();
+    return invalid;
+}
+
+void PickBuffer::begin(const QRect& area)
+{
+    m_area = area.intersected(m_buffer.image().rect());
+    m_commands.clear();
+}
+
+void PickBuffer::render()
+{
+    if (m_area.isEmpty()) return;
+
+    // Nothing under the area until the shapes say otherwise
+    QImage& image = m_buffer.image();
+    for (int y = m_area.top(); y <= m_area.bottom(); ++y) {
+        QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+        std::fill(row + m_area.left(), row + m_area.right() + 1, 0u);
+    }
+
+    m_buffer.setClipRect(m_area);
+    for (const Command& command : m_commands) {
+        command.draw(command.shape, m_buffer, color(command.id, Interior), 0, 0);
+    }
+    for (const Command& command : m_commands) {
+        command.draw(command.shape, m_buffer, 0, color(command.id, Edge), 0);
+    }
+    for (const Command& command : m_commands) {
+        command.draw(command.shape, m_buffer, 0, 0, color(command.id, Vertex));
+    }
+    m_buffer.setClipRect(QRect());
+}
+
+PickBuffer::Hit PickBuffer::at(const QPoint& point) const
+{
+    Hit hit;
+    const QImage& image = m_buffer.image();
+    if (!image.rect().contains(point)) return hit;
+
+    const QRgb value = reinterpret_cast<const QRgb*>(image.constScanLine(point.y()))[point.x()] & 0xffffff;
+    const Handle handle = static_cast<Handle>(value & ((1u << HandleBits) - 1));
+    const quint32 id = value >> HandleBits;
+    if (handle == None || id >= m_owners.size() || !m_owners[id].shape) return hit;
+
+    const Owner& owner = m_owners[id];
+    switch (owner.kind) {
+    case LineShape:
+        hit.line = static_cast<Line*>(owner.shape);
+        break;
+    case CircleShape:
+        hit.circle = static_cast<Circle*>(owner.shape);
+        break;
+    case PolygonShape:
+        hit.polygon = static_cast<Polygon*>(owner.shape);
+        break;
+    case RectangleShape:
+        hit.rectangle = static_cast<Rectangle*>(owner.shape);
+        break;
+    }
+    hit.handle = handle;
+    return hit;
+}
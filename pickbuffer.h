@@ -0,0 +1,124 @@
+#ifndef PICKBUFFER_H
+#define PICKBUFFER_H
+
+#include <QPoint>
+#include <QRect>
+#include <QRegion>
+#include <QSize>
+#include <QtGlobal>
+#include <unordered_map>
+#include <vector>
+#include "circle.h"
+#include "framebuffer.h"
+#include "line.h"
+#include "polygon.h"
+#include "rectangle.h"
+
+// Offscreen image naming the shape part under every pixel of the canvas.
+// Shapes are rasterized into it with their own drawPick(): the stroke, span
+// and handle code that draws them, at their brush widths but without
+// anti-aliasing, in an ID color instead of their colors. Interiors go first,
+// then outlines, then handles, each in stacking order, so a handle wins over
+// the outline beneath it and an outline over an interior. Only filled
+// interiors are drawn: an unfilled one shows what is beneath it, so it must
+// not hide that from clicks either.
+//
+// Only areas invalidated since the last read are redrawn, through a display
+// list like TileRenderer's, so a click or hover is a single pixel read.
+//
+// A pixel stores a 22-bit shape ID and a 2-bit Handle under an opaque alpha
+// (the rasterizers only write opaque colors unblended), 0 meaning nothing.
+class PickBuffer {
+public:
+    enum Handle {
+        None,
+        Interior,
+        Edge,
+        Vertex
+    };
+
+    // The topmost part under a pixel; at most one shape pointer is set
+    struct Hit {
+        Line* line = nullptr;
+        Circle* circle = nullptr;
+        Polygon* polygon = nullptr;
+        Rectangle* rectangle = nullptr;
+        Handle handle = None;
+    };
+
+    // Mark area (everything if null) for redrawing before the next read
+    void invalidate(const QRect& area = QRect());
+
+    // Drop the ID of a shape about to be deleted; its area must have been
+    // invalidated, which redraws its pixels before the ID is handed out again
+    void forget(const void* shape);
+    void clear(); // forget every shape
+
+    // Resize to the canvas and return the areas to redraw, clearing them from
+    // the invalid region; each is then drawn with begin(), add() and render()
+    QRegion takeInvalid(const QSize& size);
+
+    void begin(const QRect& area);
+    template <class Shape>
+    void add(Shape* shape); // in stacking order
+    void render();
+
+    Hit at(const QPoint& point) const;
+
+private:
+    static constexpr int HandleBits = 2;
+    static constexpr quint32 MaxIds = 1u << 22;
+
+    enum Kind {
+        LineShape,
+        CircleShape,
+        PolygonShape,
+        RectangleShape
+    };
+
+    struct Owner {
+        Kind kind;
+        void* shape;
+    };
+
+    struct Command {
+        const void* shape;
+        quint32 id;
+        void (*draw)(const void* shape, Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles);
+    };
+
+    template <class Shape>
+    static void drawShape(const void* shape, Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles)
+    {
+        static_cast<const Shape*>(shape)->drawPick(fb, interior, outline, handles);
+    }
+
+    static Kind kindOf(const Line*) { return LineShape; }
+    static Kind kindOf(const Circle*) { return CircleShape; }
+    static Kind kindOf(const Polygon*) { return PolygonShape; }
+    static Kind kindOf(const Rectangle*) { return RectangleShape; }
+
+    static QRgb color(quint32 id, Handle handle) { return 0xff000000u | (id << HandleBits) | handle; }
+
+    // ID of shape, assigning a free one on first use; false once all are taken
+    bool idOf(Kind kind, void* shape, quint32& id);
+
+    Framebuffer m_buffer;
+    QRegion m_invalid;
+    QRect m_area;                     // being redrawn
+    std::vector<Command> m_commands;  // display list for m_area
+    std::vector<Owner> m_owners;      // indexed by ID
+    std::vector<quint32> m_freeIds;
+    std::unordered_map<const void*, quint32> m_ids;
+};
+
+template <class Shape>
+void PickBuffer::add(Shape* shape)
+{
+    quint32 id;
+    if (idOf(kindOf(shape), shape, id)) {
+        m_commands.push_back(Command{ shape, id, &drawShape<Shape> });
+    }
+}
+
+#endif // PICKBUFFER_H
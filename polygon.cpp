@@ -1,198 +1,108 @@
 #include "polygon.h"
-#include <QPainter>
+#include "coveragefill.h"
+#include "scanlinefill.h"
+#include "stroke.h"
 #include <cmath>
 #include <algorithm>
 #include <QDebug>
-#include <limits>
-#include <QPainterPath>
 #include <QImage>
 #include <QString>
 
 Polygon::Polygon()
-    : m_brush(1)
 {
 }
 
 void Polygon::setThickness(int thickness)
 {
     m_thickness = std::max(1, thickness);
-    m_brush = Brush(m_thickness);
+    m_brush = &Brush::forSize(m_thickness);
+    ++m_version;
 }
 
-void Polygon::draw(QPainter& painter)
+void Polygon::draw(Framebuffer& fb)
 {
-    // First fill interior if needed
-    if (m_isImageFilled && !m_fillImage.isNull()) {
-        fillWithImage(painter);
-    } else if (m_isFilled) {
-        fillScanline(painter);
-    }
-    painter.setPen(QPen(m_color, 1)); // Use 1-pixel pen for brush drawing
-    drawEdges(painter);
-    drawVertices(painter);
+    m_sprite.draw(fb, *this);
 }
 
-void Polygon::drawEdges(QPainter& painter)
-{
-    if (m_vertices.size() < 2) return;
-
-    for (size_t i = 0; i < m_vertices.size(); ++i) {
-        const QPoint& start = m_vertices[i];
-        const QPoint& end = m_vertices[(i + 1) % m_vertices.size()];
-        
-        if (!m_isClosed && i == m_vertices.size() - 1) break;
-        
-        if (m_brush.isAntiAliasing()) {
-            drawWuLine(painter, start, end);
-        } else {
-            // Use DDA algorithm for line drawing
-            int x1 = start.x();
-            int y1 = start.y();
-            int x2 = end.x();
-            int y2 = end.y();
-            
-            int dx = x2 - x1;
-            int dy = y2 - y1;
-            
-            int steps = std::max(abs(dx), abs(dy));
-            
-            float xIncrement = dx / (float)steps;
-            float yIncrement = dy / (float)steps;
-            
-            float x = x1;
-            float y = y1;
-            
-            for (int j = 0; j <= steps; j++) {
-                drawWithBrush(painter, round(x), round(y));
-                x += xIncrement;
-                y += yIncrement;
-            }
-        }
-    }
-}
+void Polygon::prepareDraw(const Framebuffer& fb)
+{
+    m_sprite.prepare(*this);
+    if (m_sprite.isCurrent(m_version) || !m_isClosed || m_vertices.size() < 3) return;
 
-void Polygon::drawWuLine(QPainter& painter, const QPoint& start, const QPoint& end)
-{
-    int x1 = start.x();
-    int y1 = start.y();
-    int x2 = end.x();
-    int y2 = end.y();
-
-    // Calculate differences
-    int dx = x2 - x1;
-    int dy = y2 - y1;
-
-    // Handle vertical lines
-    if (dx == 0) {
-        int y = std::min(y1, y2);
-        int yEnd = std::max(y1, y2);
-        while (y <= yEnd) {
-            painter.setPen(QPen(m_color, 1));
-            painter.drawPoint(x1, y);
-            y++;
-        }
-        return;
+    // render() builds these on first use; do it here, before several tiles
+    // read them at once
+    if (m_isImageFilled && !m_fillImage.isNull()) {
+        QPoint origin;
+        fillTexture(fb.image().rect(), origin);
+        fillSpans();
+    } else if (m_isFilled && !m_antiAliasing) {
+        fillSpans();
     }
+}
 
-    // Handle horizontal lines
-    if (dy == 0) {
-        int x = std::min(x1, x2);
-        int xEnd = std::max(x1, x2);
-        while (x <= xEnd) {
-            painter.setPen(QPen(m_color, 1));
-            painter.drawPoint(x, y1);
-            x++;
-        }
-        return;
-    }
+void Polygon::paint(Framebuffer& fb)
+{
+    m_sprite.paint(fb, *this);
+}
 
-    // Determine if the line is steep
-    bool steep = std::abs(dy) > std::abs(dx);
-    
-    // If steep, swap x and y coordinates
-    if (steep) {
-        std::swap(x1, y1);
-        std::swap(x2, y2);
-        std::swap(dx, dy);
+void Polygon::render(Framebuffer& fb)
+{
+    // First fill interior if needed
+    if (m_isImageFilled && !m_fillImage.isNull()) {
+        fillWithImage(fb);
+    } else if (m_isFilled && m_antiAliasing) {
+        fillAntiAliased(fb);
+    } else if (m_isFilled) {
+        fillScanline(fb);
     }
+    drawEdges(fb);
+    drawVertices(fb, Framebuffer::premultiply(Qt::black));
+}
 
-    // Ensure we're always drawing from left to right
-    if (x1 > x2) {
-        std::swap(x1, x2);
-        std::swap(y1, y2);
-        dx = -dx;
-        dy = -dy;
+void Polygon::drawPick(Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles) const
+{
+    const bool isFilled = m_isFilled || (m_isImageFilled && !m_fillImage.isNull());
+    if (interior && isFilled && m_isClosed && m_vertices.size() >= 3) {
+        ScanlineFill::fill(fb, fillSpans(), interior);
     }
-
-    float gradient = static_cast<float>(dy) / dx;
-    float y = y1;
-
-    // Main loop
-    for (int x = x1; x <= x2; x++) {
-        // Calculate the two y values
-        int yFloor = static_cast<int>(y);
-        int yCeil = yFloor + 1;
-        float intensity = y - yFloor;
-
-        // Draw the two pixels
-        QColor color1 = m_color;
-        QColor color2 = m_color;
-        color1.setAlphaF(1.0f - intensity);
-        color2.setAlphaF(intensity);
-
-        if (steep) {
-            // For steep lines, swap back x and y coordinates when drawing
-            painter.setPen(QPen(color1, 1));
-            painter.drawPoint(yFloor, x);
-            painter.setPen(QPen(color2, 1));
-            painter.drawPoint(yCeil, x);
-        } else {
-            painter.setPen(QPen(color1, 1));
-            painter.drawPoint(x, yFloor);
-            painter.setPen(QPen(color2, 1));
-            painter.drawPoint(x, yCeil);
-        }
-
-        y += gradient;
+    if (outline) {
+        strokePolyline(fb, m_vertices.data(), static_cast<int>(m_vertices.size()), m_isClosed, *m_brush, false,
+                       outline);
     }
+    if (handles) drawVertices(fb, handles);
 }
 
-void Polygon::drawWithBrush(QPainter& painter, int x, int y)
+void Polygon::drawEdges(Framebuffer& fb)
 {
-    const auto& pattern = m_brush.getPattern();
-    int size = m_brush.getSize();
-    int halfSize = size / 2;
-    
-    for (int dy = 0; dy < size; ++dy) {
-        for (int dx = 0; dx < size; ++dx) {
-            if (pattern[dy][dx]) {
-                painter.drawPoint(x + dx - halfSize, y + dy - halfSize);
-            }
-        }
-    }
+    strokePolyline(fb, m_vertices.data(), static_cast<int>(m_vertices.size()), m_isClosed,
+                   *m_brush, m_antiAliasing, Framebuffer::premultiply(m_color));
 }
 
-void Polygon::drawVertices(QPainter& painter)
+void Polygon::drawVertices(Framebuffer& fb, QRgb color) const
 {
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::black);
-    
     for (const auto& vertex : m_vertices) {
-        painter.drawRect(vertex.x() - VERTEX_SIZE/2,
-                        vertex.y() - VERTEX_SIZE/2,
-                        VERTEX_SIZE, VERTEX_SIZE);
+        fb.fillRect(QRect(vertex.x() - VERTEX_SIZE/2,
+                          vertex.y() - VERTEX_SIZE/2,
+                          VERTEX_SIZE + 1, VERTEX_SIZE + 1), color);
     }
 }
 
 void Polygon::addVertex(const QPoint& vertex)
 {
     m_vertices.push_back(vertex);
+    m_fillSpansValid = false;
+    m_vertexBoundsValid = false;
+    m_edgeGridValid = false;
+    ++m_version;
 }
 
 void Polygon::close()
 {
     if (m_vertices.size() >= 3) {
         m_isClosed = true;
+        m_fillSpansValid = false;
+        m_edgeGridValid = false; // adds the closing edge
+        ++m_version;
     }
 }
 
@@ -200,6 +110,10 @@ void Polygon::setVertex(int index, const QPoint& point)
 {
     if (index >= 0 && index < static_cast<int>(m_vertices.size())) {
         m_vertices[index] = point;
+        m_fillSpansValid = false;
+        m_vertexBoundsValid = false;
+        m_edgeGridValid = false;
+        ++m_version;
     }
 }
 
@@ -213,76 +127,71 @@ QPoint Polygon::getVertex(int index) const
 
 bool Polygon::isNearVertex(const QPoint& point, int& vertexIndex) const
 {
-    for (size_t i = 0; i < m_vertices.size(); ++i) {
-        int dx = point.x() - m_vertices[i].x();
-        int dy = point.y() - m_vertices[i].y();
-        int distanceSquared = dx * dx + dy * dy;
-        
-        if (distanceSquared <= (VERTEX_SIZE * VERTEX_SIZE)) {
-            vertexIndex = static_cast<int>(i);
-            return true;
-        }
+    if (m_vertices.size() == 1) {
+        int dx = point.x() - m_vertices[0].x();
+        int dy = point.y() - m_vertices[0].y();
+        if (dx * dx + dy * dy > VERTEX_SIZE * VERTEX_SIZE) return false;
+        vertexIndex = 0;
+        return true;
     }
-    return false;
+
+    int index = edgeGrid().firstVertex(m_vertices, point, VERTEX_SIZE);
+    if (index < 0) return false;
+    vertexIndex = index;
+    return true;
 }
 
 bool Polygon::isNearEdge(const QPoint& point, int& edgeIndex) const
 {
     if (m_vertices.size() < 2) return false;
-    
-    for (size_t i = 0; i < m_vertices.size(); ++i) {
-        const QPoint& start = m_vertices[i];
-        const QPoint& end = m_vertices[(i + 1) % m_vertices.size()];
-        
-        if (!m_isClosed && i == m_vertices.size() - 1) break;
-        
-        // Calculate distance from point to line segment
-        int x = point.x();
-        int y = point.y();
-        int x1 = start.x();
-        int y1 = start.y();
-        int x2 = end.x();
-        int y2 = end.y();
-        
-        float lineLength = sqrt(pow(x2 - x1, 2) + pow(y2 - y1, 2));
-        float distance = abs((y2 - y1) * x - (x2 - x1) * y + x2 * y1 - y2 * x1) / lineLength;
-        
-        // Check if point is within a certain threshold of the line
-        if (distance <= m_thickness) {
-            edgeIndex = static_cast<int>(i);
-            return true;
-        }
-    }
-    return false;
+
+    // Distance to the segment itself, not to the line through it
+    int index = edgeGrid().nearestEdge(point, m_thickness);
+    if (index < 0) return false;
+    edgeIndex = index;
+    return true;
 }
 
 bool Polygon::contains(const QPoint& point) const
 {
     if (!m_isClosed || m_vertices.size() < 3) return false;
-    
-    // Check if point is near any vertex or edge
-    int vertexIndex, edgeIndex;
-    if (isNearVertex(point, vertexIndex) || isNearEdge(point, edgeIndex)) {
+
+    // The interior spans are sorted by row and then by x: two binary searches
+    const std::vector<ScanlineFill::Span>& spans = fillSpans();
+    auto row = std::equal_range(spans.begin(), spans.end(), ScanlineFill::Span{ point.y(), 0, 0 },
+                                [](const ScanlineFill::Span& a, const ScanlineFill::Span& b) { return a.y < b.y; });
+    auto after = std::upper_bound(row.first, row.second, point.x(),
+                                  [](int x, const ScanlineFill::Span& span) { return x < span.x0; });
+    if (after != row.first && std::prev(after)->x1 >= point.x()) {
         return true;
     }
-    
-    // Ray casting algorithm for point-in-polygon test
-    bool inside = false;
-    for (size_t i = 0, j = m_vertices.size() - 1; i < m_vertices.size(); j = i++) {
-        if (((m_vertices[i].y() > point.y()) != (m_vertices[j].y() > point.y())) &&
-            (point.x() < (m_vertices[j].x() - m_vertices[i].x()) * (point.y() - m_vertices[i].y()) / 
-            (m_vertices[j].y() - m_vertices[i].y()) + m_vertices[i].x())) {
-            inside = !inside;
-        }
-    }
-    return inside;
+
+    // Points on the outline or a vertex handle count too
+    int vertexIndex, edgeIndex;
+    return isNearVertex(point, vertexIndex) || isNearEdge(point, edgeIndex);
 }
 
 void Polygon::move(const QPoint& offset)
+{
+    translate(offset);
+}
+
+void Polygon::translate(const QPoint& offset)
 {
     for (auto& vertex : m_vertices) {
         vertex += offset;
     }
+
+    m_fillShader.translate(offset);
+    m_vertexBounds.translate(offset);
+    m_edgeGrid.translate(offset);
+
+    // A translated interior is the same spans shifted
+    for (auto& span : m_fillSpans) {
+        span.y += offset.y();
+        span.x0 += offset.x();
+        span.x1 += offset.x();
+    }
 }
 
 std::pair<QPoint, QPoint> Polygon::getEdgePoints(int edgeIndex) const
@@ -310,107 +219,129 @@ void Polygon::moveEdge(int edgeIndex, const QPoint& offset)
     if (m_isClosed || edgeIndex < static_cast<int>(m_vertices.size()) - 1) {
         m_vertices[nextIndex] += offset;
     }
+    m_fillSpansValid = false;
+    m_vertexBoundsValid = false;
+    m_edgeGridValid = false;
+    ++m_version;
 }
 
 // ==== Scan-line fill implementation ====
-void Polygon::fillScanline(QPainter& painter) const
+void Polygon::fillScanline(Framebuffer& fb) const
 {
     if (!m_isClosed || m_vertices.size() < 3)
         return;
 
-    struct EdgeEntry {
-        int yMax;          // maximum y of the edge
-        double x;          // x intersection with current scanline
-        double invSlope;   // 1/m = dx/dy
-    };
-
-    // Build Edge Table (ET) as a vector indexed by y
-    int minY = std::numeric_limits<int>::max();
-    int maxY = std::numeric_limits<int>::min();
-    for (const auto& v : m_vertices) {
-        minY = std::min(minY, v.y());
-        maxY = std::max(maxY, v.y());
-    }
-    if (minY == maxY) return; // degenerate
-
-    int tableHeight = maxY - minY + 1;
-    std::vector<std::vector<EdgeEntry>> edgeTable(tableHeight);
-
-    auto addEdge = [&](const QPoint& p1, const QPoint& p2) {
-        // Ignore horizontal edges
-        if (p1.y() == p2.y())
-            return;
-        int yMin = p1.y() < p2.y() ? p1.y() : p2.y();
-        int yMaxEdge = p1.y() > p2.y() ? p1.y() : p2.y();
-        double xOfYMin = (p1.y() < p2.y()) ? p1.x() : p2.x();
-        double invSlope = static_cast<double>(p2.x() - p1.x()) / static_cast<double>(p2.y() - p1.y());
-        edgeTable[yMin - minY].push_back({yMaxEdge, xOfYMin, invSlope});
-    };
-
-    for (size_t i = 0; i < m_vertices.size(); ++i) {
-        const QPoint& v1 = m_vertices[i];
-        const QPoint& v2 = m_vertices[(i + 1) % m_vertices.size()];
-        addEdge(v1, v2);
+    ScanlineFill::fill(fb, fillSpans(), m_fillShader);
+}
+
+const std::vector<ScanlineFill::Span>& Polygon::fillSpans() const
+{
+    // The interior only changes with the vertices, so the spans are kept
+    // between frames and rebuilt on demand
+    if (!m_fillSpansValid) {
+        ScanlineFill::scratch().rasterize(m_vertices.data(), static_cast<int>(m_vertices.size()), m_fillRule,
+                                          m_fillSpans);
+        m_fillSpansValid = true;
     }
+    return m_fillSpans;
+}
 
-    // Active Edge Table (AET)
-    std::vector<EdgeEntry> AET;
-
-    // Iterate scanlines from minY to maxY
-    for (int y = minY; y <= maxY; ++y) {
-        // 1. Move edges starting at y into AET
-        const auto& bucket = edgeTable[y - minY];
-        AET.insert(AET.end(), bucket.begin(), bucket.end());
-
-        // 2. Remove from AET edges where y == yMax
-        AET.erase(std::remove_if(AET.begin(), AET.end(), [y](const EdgeEntry& e) {
-            return e.yMax == y;
-        }), AET.end());
-
-        // 3. Sort AET by current x
-        std::sort(AET.begin(), AET.end(), [](const EdgeEntry& a, const EdgeEntry& b) {
-            return a.x < b.x;
-        });
-
-        // 4. Fill pixels between pairs of intersections
-        painter.setPen(QPen(m_fillColor, 1));
-        for (size_t i = 0; i + 1 < AET.size(); i += 2) {
-            int xStart = static_cast<int>(std::ceil(AET[i].x));
-            int xEnd   = static_cast<int>(std::floor(AET[i + 1].x));
-            if (xEnd >= xStart) {
-                painter.drawLine(xStart, y, xEnd, y);
-            }
-        }
+void Polygon::fillAntiAliased(Framebuffer& fb) const
+{
+    if (!m_isClosed || m_vertices.size() < 3)
+        return;
 
-        // 5. Increment y; handled by loop; 6. For each edge in AET, update x += invSlope
-        for (auto& edge : AET) {
-            edge.x += edge.invSlope;
-        }
-    }
+    CoverageFill::scratch().fill(fb, m_vertices.data(), static_cast<int>(m_vertices.size()), m_fillRule,
+                                 m_fillShader);
+}
+
+void Polygon::setFillColor(const QColor& color)
+{
+    m_fillColor = color;
+    m_fillShader = FillShader::solid(color);
+    ++m_version;
+}
+
+void Polygon::setFillRule(Qt::FillRule rule)
+{
+    if (rule == m_fillRule) return;
+    m_fillRule = rule;
+    m_fillSpansValid = false;
+    ++m_version;
 }
 
 // ==== Image fill implementation ====
-void Polygon::fillWithImage(QPainter& painter) const
+void Polygon::fillWithImage(Framebuffer& fb) const
 {
     if (!m_isClosed || m_vertices.size() < 3 || m_fillImage.isNull())
         return;
 
-    // Build path
-    QPainterPath path;
-    path.moveTo(m_vertices[0]);
-    for (size_t i = 1; i < m_vertices.size(); ++i) {
-        path.lineTo(m_vertices[i]);
+    QPoint origin;
+    const QImage* texture = fillTexture(fb.image().rect(), origin);
+    if (texture) ScanlineFill::fillTexture(fb, fillSpans(), *texture, origin);
+}
+
+const QImage* Polygon::fillTexture(const QRect& target, QPoint& origin) const
+{
+    // The image is stretched over the vertex bounding box
+    int minX = m_vertices[0].x(), maxX = minX;
+    int minY = m_vertices[0].y(), maxY = minY;
+    for (const QPoint& vertex : m_vertices) {
+        minX = std::min(minX, vertex.x());
+        maxX = std::max(maxX, vertex.x());
+        minY = std::min(minY, vertex.y());
+        maxY = std::max(maxY, vertex.y());
     }
-    path.closeSubpath();
+    const QPoint boxOrigin(minX, minY);
+    const QSize size(maxX - minX + 1, maxY - minY + 1);
+
+    // Only the on-screen part is resampled, and only when the image, the box
+    // size or that part changes; moving a shape inside the view reuses it
+    QRect visible = QRect(boxOrigin, size).intersected(target).translated(-boxOrigin);
+    if (visible.isEmpty()) return nullptr;
+    ScaledTexture::Filter filter = m_antiAliasing ? ScaledTexture::Bilinear : ScaledTexture::Nearest;
+    origin = boxOrigin + visible.topLeft();
+    return &m_fillTexture.scaled(m_fillImage, size, visible, filter);
+}
+
+QRect Polygon::boundingRect() const
+{
+    if (m_vertices.empty()) return QRect();
 
-    painter.save();
-    painter.setClipPath(path);
+    // Brush radius (plus a pixel of anti-aliasing) or the handle, whichever is larger
+    int margin = std::max(m_thickness / 2 + 2, VERTEX_SIZE / 2 + 1);
+    return vertexBounds().adjusted(-margin, -margin, margin, margin);
+}
+
+QRect Polygon::hitBounds() const
+{
+    if (m_vertices.empty()) return QRect();
 
-    // Choose bounding rect to draw image (scaled to fit)
-    QRectF bbox = path.boundingRect();
-    painter.drawImage(bbox, m_fillImage);
+    // Vertices are picked within VERTEX_SIZE, edges within the thickness
+    int margin = std::max(m_thickness, VERTEX_SIZE);
+    return vertexBounds().adjusted(-margin, -margin, margin, margin);
+}
 
-    painter.restore();
+const EdgeGrid& Polygon::edgeGrid() const
+{
+    if (!m_edgeGridValid) {
+        m_edgeGrid.build(m_vertices, m_isClosed);
+        m_edgeGridValid = true;
+    }
+    return m_edgeGrid;
+}
+
+const QRect& Polygon::vertexBounds() const
+{
+    // Queried for every polygon on every repaint, so the vertex scan is cached
+    if (!m_vertexBoundsValid) {
+        m_vertexBounds = QRect(m_vertices[0], QSize(1, 1));
+        for (const QPoint& vertex : m_vertices) {
+            m_vertexBounds |= QRect(vertex, QSize(1, 1));
+        }
+        m_vertexBoundsValid = true;
+    }
+    return m_vertexBounds;
 }
 
 bool Polygon::isConvex() const
@@ -1,11 +1,16 @@
 #ifndef POLYGON_H
 #define POLYGON_H
 
-#include <QPainter>
 #include <QColor>
 #include <QPoint>
 #include <vector>
 #include "brush.h"
+#include "edgegrid.h"
+#include "fillshader.h"
+#include "framebuffer.h"
+#include "scaledtexture.h"
+#include "scanlinefill.h"
+#include "shapesprite.h"
 #include <QImage>
 #include <QString>
 
@@ -13,7 +18,11 @@ class Polygon {
 public:
     Polygon();
     
-    void draw(QPainter& painter);
+    void draw(Framebuffer& fb);
+    // draw() in two steps for TileRenderer: prepareDraw() also builds the
+    // fill caches, so concurrent paint() calls only read them
+    void prepareDraw(const Framebuffer& fb);
+    void paint(Framebuffer& fb);
     bool contains(const QPoint& point) const;
     void move(const QPoint& offset);
     void addVertex(const QPoint& vertex);
@@ -26,42 +35,74 @@ public:
     bool isNearVertex(const QPoint& point, int& vertexIndex) const;
     bool isNearEdge(const QPoint& point, int& edgeIndex) const;
     
-    void setColor(const QColor& color) { m_color = color; }
+    void setColor(const QColor& color) { m_color = color; ++m_version; }
     QColor getColor() const { return m_color; }
     
     void setThickness(int thickness);
     int getThickness() const { return m_thickness; }
 
-    void setAntiAliasing(bool enabled) { m_brush.setAntiAliasing(enabled); }
-    bool isAntiAliasing() const { return m_brush.isAntiAliasing(); }
+    void setAntiAliasing(bool enabled) { m_antiAliasing = enabled; ++m_version; }
+    bool isAntiAliasing() const { return m_antiAliasing; }
 
     // New methods for edge manipulation
     std::pair<QPoint, QPoint> getEdgePoints(int edgeIndex) const;
     void moveEdge(int edgeIndex, const QPoint& offset);
 
     // New fill related APIs
-    void setFilled(bool filled) { m_isFilled = filled; }
+    void setFilled(bool filled) { m_isFilled = filled; ++m_version; }
     bool isFilled() const { return m_isFilled; }
-    void setFillColor(const QColor& color) { m_fillColor = color; }
+    void setFillColor(const QColor& color); // also makes the fill solid
     QColor getFillColor() const { return m_fillColor; }
 
+    // Gradient / pattern fills; the shader moves along with the polygon
+    void setFillShader(const FillShader& shader) { m_fillShader = shader; ++m_version; }
+    const FillShader& getFillShader() const { return m_fillShader; }
+
     // Image fill APIs
-    void setImageFilled(bool filled) { m_isImageFilled = filled; }
+    void setImageFilled(bool filled) { m_isImageFilled = filled; ++m_version; }
     bool isImageFilled() const { return m_isImageFilled; }
-    void setFillImage(const QImage& image) { m_fillImage = image; }
+    void setFillImage(const QImage& image) { m_fillImage = image; ++m_version; }
     const QImage& getFillImage() const { return m_fillImage; }
     void setFillImagePath(const QString& path) { m_fillImagePath = path; }
     QString getFillImagePath() const { return m_fillImagePath; }
 
+    // Which regions of a self-intersecting outline count as inside
+    void setFillRule(Qt::FillRule rule);
+    Qt::FillRule getFillRule() const { return m_fillRule; }
+
     bool isConvex() const; // New helper to test convexity
 
+    // Every pixel draw() can touch, vertex handles included
+    QRect boundingRect() const;
+
+    // Every point contains() or isNear*() can accept, and every pixel
+    // drawPick() writes, lies inside
+    QRect hitBounds() const;
+
+    // Rasterize into a PickBuffer: the parts draw() shows, the interior only
+    // when filled, with the same brush but no anti-aliasing, each in one flat
+    // color (0 skips the part)
+    void drawPick(Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles) const;
+
 private:
-    void drawEdges(QPainter& painter);
-    void drawVertices(QPainter& painter);
-    void drawWithBrush(QPainter& painter, int x, int y);
-    void drawWuLine(QPainter& painter, const QPoint& start, const QPoint& end);
-    void fillScanline(QPainter& painter) const;  // Scan-line fill helper
-    void fillWithImage(QPainter& painter) const; // New image fill helper
+    friend class ShapeSprite;
+    friend class RenderThread;
+    void render(Framebuffer& fb);
+    void translate(const QPoint& offset);
+    quint64 spriteVersion() const { return m_version; }
+    QPoint spriteAnchor() const { return m_vertices.empty() ? QPoint() : m_vertices[0]; }
+    void releaseSprite() { m_sprite.clear(); }
+    void drawEdges(Framebuffer& fb);
+    void drawVertices(Framebuffer& fb, QRgb color) const;
+    void fillScanline(Framebuffer& fb) const;  // Scan-line fill helper
+    void fillAntiAliased(Framebuffer& fb) const; // Area-coverage fill helper
+    void fillWithImage(Framebuffer& fb) const; // New image fill helper
+    // Fill image scaled to the vertex bounds and cut to what lies inside
+    // target (null if nothing does); origin gets its canvas position
+    const QImage* fillTexture(const QRect& target, QPoint& origin) const;
+    const std::vector<ScanlineFill::Span>& fillSpans() const; // cached interior spans
+    const QRect& vertexBounds() const;                         // cached, vertices only
+    const EdgeGrid& edgeGrid() const;                          // cached, for the hit tests
     
     std::vector<QPoint> m_vertices;
     bool m_isClosed = false;
@@ -69,10 +110,22 @@ private:
     bool m_isImageFilled = false;  // indicates whether polygon should be filled with image
     QColor m_color = Qt::black;
     QColor m_fillColor = Qt::yellow; // fill color when m_isFilled is true
+    FillShader m_fillShader;         // what m_isFilled paints (solid m_fillColor by default)
     QImage m_fillImage;              // image when m_isImageFilled is true
     QString m_fillImagePath;         // optional: path of the fill image
     int m_thickness = 1;
-    Brush m_brush;
+    const Brush* m_brush = &Brush::forSize(1); // shared, see Brush::forSize
+    bool m_antiAliasing = false;
+    Qt::FillRule m_fillRule = Qt::OddEvenFill;
+    mutable std::vector<ScanlineFill::Span> m_fillSpans; // cached interior for the scanline fills
+    mutable bool m_fillSpansValid = false;               // cleared whenever a vertex changes
+    mutable ScaledTexture m_fillTexture;                  // fill image pre-scaled to the bounding box
+    mutable QRect m_vertexBounds;            // bounds of the vertices alone
+    mutable bool m_vertexBoundsValid = false; // cleared whenever a vertex changes
+    mutable EdgeGrid m_edgeGrid;              // edges near a point, for isNear*()
+    mutable bool m_edgeGridValid = false;     // cleared whenever a vertex changes
+    quint64 m_version = ShapeSprite::firstVersion(); // bumped by every edit except translation
+    ShapeSprite m_sprite;  // reused while the polygon is only dragged
     static const int VERTEX_SIZE = 8; // Size of the vertex squares
 };
 
@@ -1,9 +1,11 @@
 #include "rectangle.h"
+#include "segmentbuffer.h"
+#include "stroke.h"
 #include <algorithm>
 #include <cmath>
 
 Rectangle::Rectangle(const QPoint& firstCorner, const QPoint& oppositeCorner)
-    : m_firstCorner(firstCorner), m_oppositeCorner(oppositeCorner), m_brush(1)
+    : m_firstCorner(firstCorner), m_oppositeCorner(oppositeCorner)
 {
     updateVertices();
 }
@@ -38,144 +40,70 @@ void Rectangle::updateVertices()
     m_vertices[1] = topRight;
     m_vertices[2] = bottomRight;
     m_vertices[3] = bottomLeft;
+    ++m_version;
 }
 
 void Rectangle::setThickness(int thickness)
 {
     m_thickness = std::max(1, thickness);
-    m_brush = Brush(m_thickness);
+    m_brush = &Brush::forSize(m_thickness);
+    ++m_version;
 }
 
-void Rectangle::draw(QPainter& painter)
+void Rectangle::draw(Framebuffer& fb)
 {
-    painter.setPen(QPen(m_color, 1)); // pen width 1, brush handles thickness
-    drawEdges(painter);
-    drawVertices(painter);
+    m_sprite.draw(fb, *this);
 }
 
-void Rectangle::drawEdges(QPainter& painter)
+void Rectangle::prepareDraw(const Framebuffer&)
 {
-    if (m_vertices.size() != 4) return;
-    for (int i = 0; i < 4; ++i) {
-        const QPoint& start = m_vertices[i];
-        const QPoint& end   = m_vertices[(i + 1) % 4];
-        if (m_brush.isAntiAliasing()) {
-            drawWuLine(painter, start, end);
-        } else {
-            // DDA similar to polygon
-            int x1 = start.x();
-            int y1 = start.y();
-            int x2 = end.x();
-            int y2 = end.y();
-            int dx = x2 - x1;
-            int dy = y2 - y1;
-            int steps = std::max(std::abs(dx), std::abs(dy));
-            float xInc = dx / static_cast<float>(steps);
-            float yInc = dy / static_cast<float>(steps);
-            float x = x1;
-            float y = y1;
-            for (int s = 0; s <= steps; ++s) {
-                drawWithBrush(painter, std::round(x), std::round(y));
-                x += xInc;
-                y += yInc;
-            }
-        }
-    }
+    m_sprite.prepare(*this);
 }
 
-void Rectangle::drawWithBrush(QPainter& painter, int x, int y)
+void Rectangle::paint(Framebuffer& fb)
 {
-    const auto& pattern = m_brush.getPattern();
-    int size = m_brush.getSize();
-    int halfSize = size / 2;
-    for (int dy = 0; dy < size; ++dy) {
-        for (int dx = 0; dx < size; ++dx) {
-            if (pattern[dy][dx]) {
-                painter.drawPoint(x + dx - halfSize, y + dy - halfSize);
-            }
-        }
-    }
+    m_sprite.paint(fb, *this);
 }
 
-void Rectangle::drawVertices(QPainter& painter)
+void Rectangle::render(Framebuffer& fb)
 {
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::black);
-    for (const auto& v : m_vertices) {
-        painter.drawRect(v.x() - VERTEX_SIZE/2, v.y() - VERTEX_SIZE/2, VERTEX_SIZE, VERTEX_SIZE);
-    }
+    drawEdges(fb);
+    drawVertices(fb, Framebuffer::premultiply(Qt::black));
 }
 
-// Wu line algorithm identical to polygon implementation, copy code
-void Rectangle::drawWuLine(QPainter& painter, const QPoint& start, const QPoint& end)
+void Rectangle::drawPick(Framebuffer& fb, QRgb, QRgb outline, QRgb handles) const
 {
-    int x1 = start.x();
-    int y1 = start.y();
-    int x2 = end.x();
-    int y2 = end.y();
-
-    int dx = x2 - x1;
-    int dy = y2 - y1;
-
-    if (dx == 0) {
-        int y = std::min(y1, y2);
-        int yEnd = std::max(y1, y2);
-        while (y <= yEnd) {
-            painter.setPen(QPen(m_color, 1));
-            painter.drawPoint(x1, y);
-            y++;
-        }
-        return;
-    }
-
-    if (dy == 0) {
-        int x = std::min(x1, x2);
-        int xEnd = std::max(x1, x2);
-        while (x <= xEnd) {
-            painter.setPen(QPen(m_color, 1));
-            painter.drawPoint(x, y1);
-            x++;
-        }
-        return;
-    }
+    if (m_vertices.size() != 4) return;
+    if (outline) strokePolyline(fb, m_vertices.data(), 4, true, *m_brush, false, outline);
+    if (handles) drawVertices(fb, handles);
+}
 
-    bool steep = std::abs(dy) > std::abs(dx);
-    if (steep) {
-        std::swap(x1, y1);
-        std::swap(x2, y2);
-        std::swap(dx, dy);
-    }
+void Rectangle::drawEdges(Framebuffer& fb)
+{
+    if (m_vertices.size() != 4) return;
+    strokePolyline(fb, m_vertices.data(), 4, true, *m_brush, m_antiAliasing,
+                   Framebuffer::premultiply(m_color));
+}
 
-    if (x1 > x2) {
-        std::swap(x1, x2);
-        std::swap(y1, y2);
-        dx = -dx;
-        dy = -dy;
+void Rectangle::drawVertices(Framebuffer& fb, QRgb color) const
+{
+    for (const auto& v : m_vertices) {
+        fb.fillRect(QRect(v.x() - VERTEX_SIZE/2, v.y() - VERTEX_SIZE/2, VERTEX_SIZE + 1, VERTEX_SIZE + 1), color);
     }
+}
 
-    float gradient = static_cast<float>(dy) / dx;
-    float y = y1;
+QRect Rectangle::boundingRect() const
+{
+    // Brush radius (plus a pixel of anti-aliasing) or the handle, whichever is larger
+    int margin = std::max(m_thickness / 2 + 2, VERTEX_SIZE / 2 + 1);
+    return QRect(m_vertices[0], m_vertices[2]).adjusted(-margin, -margin, margin, margin);
+}
 
-    for (int x = x1; x <= x2; ++x) {
-        int yFloor = static_cast<int>(y);
-        int yCeil = yFloor + 1;
-        float intensity = y - yFloor;
-        QColor c1 = m_color; QColor c2 = m_color;
-        c1.setAlphaF(1.0f - intensity);
-        c2.setAlphaF(intensity);
-        if (steep) {
-            painter.setPen(QPen(c1, 1));
-            painter.drawPoint(yFloor, x);
-            painter.setPen(QPen(c2, 1));
-            painter.drawPoint(yCeil, x);
-        } else {
-            painter.setPen(QPen(c1, 1));
-            painter.drawPoint(x, yFloor);
-            painter.setPen(QPen(c2, 1));
-            painter.drawPoint(x, yCeil);
-        }
-        y += gradient;
-    }
+QRect Rectangle::hitBounds() const
+{
+    // Vertices are picked within VERTEX_SIZE, edges within the thickness
+    int margin = std::max(m_thickness, VERTEX_SIZE);
+    return QRect(m_vertices[0], m_vertices[2]).adjusted(-margin, -margin, margin, margin);
 }
 
 QPoint Rectangle::getVertex(int index) const
@@ -201,22 +129,12 @@ bool Rectangle::isNearVertex(const QPoint& point, int& vertexIndex) const
 bool Rectangle::isNearEdge(const QPoint& point, int& edgeIndex) const
 {
     // edges 0: top between v0 v1; 1: right v1 v2; 2: bottom v2 v3; 3: left v3 v0
+    // Distance to the segment itself, not to the line through it
+    const float threshold = static_cast<float>(m_thickness) * m_thickness;
     for (int i = 0; i < 4; ++i) {
-        const QPoint& start = m_vertices[i];
-        const QPoint& end = m_vertices[(i+1)%4];
-        int x = point.x(); int y = point.y();
-        int x1 = start.x(); int y1 = start.y();
-        int x2 = end.x(); int y2 = end.y();
-        float length = std::sqrt(std::pow(x2-x1,2) + std::pow(y2-y1,2));
-        if (length == 0) continue;
-        float dist = std::abs((y2 - y1)*x - (x2 - x1)*y + x2*y1 - y2*x1)/length;
-        if (dist <= m_thickness) {
-            // Additional constraint: projection within segment
-            if ((x >= std::min(x1,x2) - VERTEX_SIZE && x <= std::max(x1,x2)+VERTEX_SIZE &&
-                 y >= std::min(y1,y2) - VERTEX_SIZE && y <= std::max(y1,y2)+VERTEX_SIZE)) {
-                edgeIndex = i;
-                return true;
-            }
+        if (SegmentBuffer::distanceSquared(point, m_vertices[i], m_vertices[(i + 1) % 4]) <= threshold) {
+            edgeIndex = i;
+            return true;
         }
     }
     return false;
@@ -238,6 +156,11 @@ bool Rectangle::contains(const QPoint& point) const
 }
 
 void Rectangle::move(const QPoint& offset)
+{
+    translate(offset);
+}
+
+void Rectangle::translate(const QPoint& offset)
 {
     m_firstCorner += offset;
     m_oppositeCorner += offset;
@@ -1,11 +1,12 @@
 #ifndef RECTANGLE_H
 #define RECTANGLE_H
 
-#include <QPainter>
 #include <QColor>
 #include <QPoint>
 #include <vector>
 #include "brush.h"
+#include "framebuffer.h"
+#include "shapesprite.h"
 
 class Rectangle {
 public:
@@ -13,7 +14,10 @@ public:
     Rectangle(const QPoint& firstCorner, const QPoint& oppositeCorner);
 
     // Rendering
-    void draw(QPainter& painter);
+    void draw(Framebuffer& fb);
+    // draw() in two steps for TileRenderer (see ShapeSprite::prepare())
+    void prepareDraw(const Framebuffer& fb);
+    void paint(Framebuffer& fb);
 
     // Geometry helpers
     bool contains(const QPoint& point) const;
@@ -30,26 +34,38 @@ public:
     void setOppositeCorner(const QPoint& p);
 
     // Appearance
-    void setColor(const QColor& color) { m_color = color; }
+    void setColor(const QColor& color) { m_color = color; ++m_version; }
     QColor getColor() const { return m_color; }
 
     void setThickness(int thickness);
     int getThickness() const { return m_thickness; }
 
-    void setAntiAliasing(bool enabled) { m_brush.setAntiAliasing(enabled); }
-    bool isAntiAliasing() const { return m_brush.isAntiAliasing(); }
+    void setAntiAliasing(bool enabled) { m_antiAliasing = enabled; ++m_version; }
+    bool isAntiAliasing() const { return m_antiAliasing; }
 
     // Debug/helper
     QPoint getVertex(int index) const;                                // returns vertex coordinates (0-3)
+    QRect boundingRect() const;                                       // every pixel draw() can touch
+    QRect hitBounds() const;                                          // every point a hit test can accept or drawPick() write
+
+    // Rasterize into a PickBuffer: the parts draw() shows (never an interior,
+    // rectangles are not filled), with the same brush but no anti-aliasing,
+    // each in one flat color (0 skips the part)
+    void drawPick(Framebuffer& fb, QRgb interior, QRgb outline, QRgb handles) const;
 
 private:
+    friend class ShapeSprite;
+    friend class RenderThread;
+    void render(Framebuffer& fb);
+    void translate(const QPoint& offset);
+    quint64 spriteVersion() const { return m_version; }
+    QPoint spriteAnchor() const { return m_vertices[0]; }
+    void releaseSprite() { m_sprite.clear(); }
     void updateVertices();                                            // recompute 4 vertices from the two stored corners
 
     // Drawing helpers
-    void drawEdges(QPainter& painter);
-    void drawVertices(QPainter& painter);
-    void drawWithBrush(QPainter& painter, int x, int y);
-    void drawWuLine(QPainter& painter, const QPoint& start, const QPoint& end);
+    void drawEdges(Framebuffer& fb);
+    void drawVertices(Framebuffer& fb, QRgb color) const;
 
     // Data
     QPoint m_firstCorner;         // one corner selected first (does not have to be top-left)
@@ -58,7 +74,10 @@ private:
 
     QColor m_color = Qt::black;
     int m_thickness = 1;
-    Brush m_brush;
+    const Brush* m_brush = &Brush::forSize(1); // shared, see Brush::forSize
+    bool m_antiAliasing = false;
+    quint64 m_version = ShapeSprite::firstVersion(); // bumped by every edit except translation
+    ShapeSprite m_sprite;         // reused while the rectangle is only dragged
 
     static const int VERTEX_SIZE = 8; // square size for vertex handles
 };
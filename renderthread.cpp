@@ -0,0 +1,300 @@
+#include "renderthread.h"
+#include <algorithm>
+#include <unordered_map>
+
+RenderThread::RenderThread(QObject* parent)
+    : QThread(parent)
+{
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_quit = true;
+        m_wake.wakeOne();
+    }
+    wait();
+}
+
+void RenderThread::submit(Scene scene)
+{
+    QMutexLocker lock(&m_mutex);
+    m_pending.push_back(std::move(scene));
+    if (!isRunning()) {
+        start();
+    }
+    m_wake.wakeOne();
+}
+
+void RenderThread::present(QPainter& painter, const QRegion& region)
+{
+    QMutexLocker lock(&m_mutex);
+    for (const QRect& area : region) {
+        painter.drawImage(area.topLeft(), m_front.image(), area);
+    }
+}
+
+void RenderThread::run()
+{
+    for (;;) {
+        std::vector<Scene> scenes;
+        {
+            QMutexLocker lock(&m_mutex);
+            while (m_pending.empty() && !m_quit) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_quit) return;
+            scenes.swap(m_pending);
+        }
+
+        QRegion changed = render(scenes);
+        if (!changed.isEmpty()) emit frameReady(changed);
+    }
+}
+
+template <class Shape>
+bool RenderThread::update(Item<Shape>& item, Item<Shape>& next)
+{
+    bool changed = false;
+    if (next.shape) {
+        item.shape = std::move(next.shape);
+        changed = true;
+    }
+
+    // Translate the copy like the canvas's original
+    QPoint offset = next.anchor - item.shape->spriteAnchor();
+    if (!offset.isNull()) {
+        item.shape->move(offset);
+        changed = true;
+    }
+    item.anchor = next.anchor;
+    return changed;
+}
+
+template <class Shape>
+bool RenderThread::apply(List<Shape>& list, Changes<Shape>& changes, bool reset)
+{
+    if (reset) {
+        // Copies of shapes not edited since they were sent (and which keep
+        // their sprite and fill caches) are taken over from the old list
+        std::vector<Item<Shape>> items = std::move(changes.added);
+        for (Item<Shape>& next : items) {
+            if (next.shape) continue;
+            auto found = list.index.find(next.key);
+            Item<Shape>& item = list.items[found->second];
+            update(item, next);
+            next.shape = std::move(item.shape);
+        }
+        list.items = std::move(items);
+        list.index.clear();
+        for (size_t i = 0; i < list.items.size(); ++i) {
+            list.index.emplace(list.items[i].key, i);
+        }
+        return true;
+    }
+
+    bool changed = false;
+    if (!changes.removed.empty()) {
+        // Drop the copies, then close the gaps from the first one, moving
+        // the survivors forward and reindexing them
+        size_t first = list.items.size();
+        for (const Shape* key : changes.removed) {
+            auto found = list.index.find(key);
+            if (found == list.index.end()) continue;
+            list.items[found->second].shape.reset();
+            first = std::min(first, found->second);
+            list.index.erase(found);
+        }
+        size_t kept = first;
+        for (size_t i = first; i < list.items.size(); ++i) {
+            if (!list.items[i].shape) continue;
+            if (kept != i) list.items[kept] = std::move(list.items[i]);
+            list.index[list.items[kept].key] = kept;
+            ++kept;
+        }
+        changed = kept != list.items.size();
+        list.items.erase(list.items.begin() + kept, list.items.end());
+    }
+    for (Item<Shape>& next : changes.updated) {
+        auto found = list.index.find(next.key);
+        if (found != list.index.end()) {
+            changed |= update(list.items[found->second], next);
+        }
+    }
+    for (Item<Shape>& next : changes.added) {
+        list.index[next.key] = list.items.size();
+        list.items.push_back(std::move(next));
+        changed = true;
+    }
+    return changed;
+}
+
+bool RenderThread::apply(Lists& lists, LayerChanges& changes, bool reset)
+{
+    // No short-circuiting: every list has to be updated
+    bool changed = apply(lists.lines, changes.lines, reset);
+    changed |= apply(lists.circles, changes.circles, reset);
+    changed |= apply(lists.polygons, changes.polygons, reset);
+    changed |= apply(lists.rectangles, changes.rectangles, reset);
+    return changed;
+}
+
+template <class Shape>
+bool RenderThread::sync(std::vector<Item<Shape>>& shapes, std::vector<Item<Shape>>& next)
+{
+    // At most one shape per list is being drawn: no index needed
+    bool changed = shapes.size() != next.size();
+    for (size_t i = 0; i < next.size(); ++i) {
+        Item<Shape>& item = next[i];
+        if (!item.shape) {
+            // Not edited since the last scene: keep the copy holding its caches
+            auto found = std::find_if(shapes.begin(), shapes.end(),
+                                      [&item](const Item<Shape>& shape) { return shape.key == item.key; });
+            item.shape = std::move(found->shape);
+            changed |= found - shapes.begin() != static_cast<std::ptrdiff_t>(i);
+        } else {
+            changed = true;
+        }
+
+        QPoint offset = item.anchor - item.shape->spriteAnchor();
+        if (!offset.isNull()) {
+            item.shape->move(offset);
+            changed = true;
+        }
+    }
+    shapes = std::move(next);
+    return changed;
+}
+
+bool RenderThread::sync(Layer& layer, Layer& next)
+{
+    // No short-circuiting: every list has to be taken over
+    bool changed = sync(layer.lines, next.lines);
+    changed |= sync(layer.circles, next.circles);
+    changed |= sync(layer.polygons, next.polygons);
+    changed |= sync(layer.rectangles, next.rectangles);
+    return changed;
+}
+
+QRegion RenderThread::render(std::vector<Scene>& scenes)
+{
+    // Scenes that queued up behind the last frame are applied in order and
+    // drawn once, over the union of their damage
+    bool changed = false;
+    QRegion sceneDamage;
+    for (Scene& next : scenes) {
+        changed |= apply(m_shapes, next.shapes, next.reset);
+        changed |= sync(m_drawing, next.drawing);
+        sceneDamage |= next.damage;
+    }
+    Scene& scene = scenes.back();
+
+    const bool resized = m_back.image().size() != scene.size;
+    const bool dragChanged = scene.dragged != m_dragged;
+    if (dragChanged) {
+        // Dropped shapes stop moving: their sprites would only hold memory
+        std::vector<const void*> dropped;
+        for (const void* key : m_dragged) {
+            if (std::find(scene.dragged.begin(), scene.dragged.end(), key) == scene.dragged.end()) {
+                dropped.push_back(key);
+            }
+        }
+        releaseSprites(dropped);
+    }
+    m_dragged = std::move(scene.dragged);
+    if (!resized && !changed && !dragChanged) return QRegion(); // the front buffer is current
+
+    const QRect bounds(QPoint(0, 0), scene.size);
+    const QRegion damage = resized ? QRegion(bounds) : sceneDamage.intersected(bounds);
+    m_back.resize(scene.size);
+    if (!m_dragged.empty() && (resized || dragChanged)) {
+        // Nothing but the dragged shapes changes until they are dropped, so
+        // everything else is rendered once here and each drag frame only
+        // copies the damaged part back and draws them on top
+        m_dragBackground.resize(scene.size);
+        drawShapes(m_dragBackground, bounds, true);
+    }
+
+    // Only damaged pixels are cleared and redrawn, and only by the shapes
+    // reaching them; the rest of the back buffer already matches the front
+    for (const QRect& area : damage) {
+        m_back.setClipRect(area);
+        if (!m_dragged.empty()) {
+            m_back.copyFrom(m_dragBackground, area);
+            drawDraggedShapes(m_back);
+        } else {
+            drawShapes(m_back, area, false);
+        }
+    }
+    m_back.setClipRect(QRect());
+
+    {
+        QMutexLocker lock(&m_mutex);
+        std::swap(m_front, m_back);
+    }
+
+    // The new back buffer still holds the frame before; copying this
+    // frame's changes over keeps the next frame incremental
+    m_back.resize(scene.size);
+    for (const QRect& area : damage) {
+        m_back.copyFrom(m_front, area);
+    }
+    return damage;
+}
+
+void RenderThread::releaseSprites(const std::vector<const void*>& keys)
+{
+    if (keys.empty()) return;
+    auto release = [&keys](auto& items) {
+        for (auto& item : items) {
+            if (std::find(keys.begin(), keys.end(), item.key) != keys.end()) item.shape->releaseSprite();
+        }
+    };
+    release(m_shapes.lines.items);
+    release(m_shapes.circles.items);
+    release(m_shapes.polygons.items);
+    release(m_shapes.rectangles.items);
+}
+
+bool RenderThread::isDragged(const void* key) const
+{
+    return std::find(m_dragged.begin(), m_dragged.end(), key) != m_dragged.end();
+}
+
+void RenderThread::drawShapes(Framebuffer& target, const QRect& area, bool skipDragged)
+{
+    // Shapes are binned into screen tiles in stacking order and the tiles
+    // are cleared and rasterized in parallel
+    m_tileRenderer.begin(target, area);
+    auto add = [&](const auto& items) {
+        for (const auto& item : items) {
+            if (!skipDragged || !isDragged(item.key)) m_tileRenderer.add(item.shape.get());
+        }
+    };
+    add(m_shapes.lines.items);
+    add(m_shapes.circles.items);
+    add(m_shapes.polygons.items);
+    add(m_shapes.rectangles.items);
+    add(m_drawing.lines);
+    add(m_drawing.circles);
+    add(m_drawing.polygons);
+    add(m_drawing.rectangles);
+    m_tileRenderer.render(Framebuffer::premultiply(Qt::white));
+}
+
+void RenderThread::drawDraggedShapes(Framebuffer& target)
+{
+    for (const auto& item : m_shapes.lines.items) {
+        if (isDragged(item.key)) item.shape->draw(target);
+    }
+    for (const auto& item : m_shapes.circles.items) {
+        if (isDragged(item.key)) item.shape->draw(target);
+    }
+    for (const auto& item : m_shapes.polygons.items) {
+        if (isDragged(item.key)) item.shape->draw(target);
+    }
+    for (const auto& item : m_shapes.rectangles.items) {
+        if (isDragged(item.key)) item.shape->draw(target);
+    }
+}
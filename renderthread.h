@@ -0,0 +1,158 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QMutex>
+#include <QPainter>
+#include <QRegion>
+#include <QThread>
+#include <QWaitCondition>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "circle.h"
+#include "framebuffer.h"
+#include "line.h"
+#include "polygon.h"
+#include "rectangle.h"
+#include "tilerenderer.h"
+
+// Rasterizes the canvas away from the GUI thread.
+// The canvas submits a copy of its scene with each paint event and presents
+// the last finished frame; it never waits for rendering. Frames go into a
+// back buffer that is swapped with the presented front buffer once done.
+// Scenes only carry what changed, so the renderer keeps its own copy of every
+// shape; scenes queued behind a slow frame are applied together and rendered
+// once, so the renderer skips ahead instead of falling behind.
+class RenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    // A shape as submitted for rendering, keyed by the canvas's own object
+    // (the key identifies the shape across scenes and is never dereferenced)
+    template <class Shape>
+    struct Item {
+        const Shape* key;
+        QPoint anchor;                // key's position
+        std::unique_ptr<Shape> shape; // copy of key, or null if the render thread has its version
+    };
+
+    // Shapes drawn in this order: lines, circles, polygons, rectangles
+    struct Layer {
+        std::vector<Item<Line>> lines;
+        std::vector<Item<Circle>> circles;
+        std::vector<Item<Polygon>> polygons;
+        std::vector<Item<Rectangle>> rectangles;
+    };
+
+    // Edits to one shape list since the previous scene, applied in this order
+    template <class Shape>
+    struct Changes {
+        std::vector<const Shape*> removed;
+        std::vector<Item<Shape>> updated; // edited or moved, keeping their place
+        std::vector<Item<Shape>> added;   // appended
+    };
+
+    struct LayerChanges {
+        Changes<Line> lines;
+        Changes<Circle> circles;
+        Changes<Polygon> polygons;
+        Changes<Rectangle> rectangles;
+    };
+
+    // Everything one frame depends on; the render thread owns it once submitted
+    struct Scene {
+        QSize size;
+        QRegion damage;                   // what changed since the previous scene
+        bool reset = false;               // shapes.added lists every shape, replacing the lists
+        LayerChanges shapes;
+        Layer drawing;                    // shape being drawn, on top of the rest (always copied)
+        std::vector<const void*> dragged; // keys drawn over a frozen copy of the rest
+    };
+
+    // Item for shape, copying it unless sentVersion says the render thread
+    // already has its current version (only its anchor may have moved since);
+    // sentVersion is then brought up to date. 0 means nothing was sent yet.
+    template <class Shape>
+    static Item<Shape> item(const Shape* shape, quint64& sentVersion);
+
+    explicit RenderThread(QObject* parent = nullptr);
+    ~RenderThread() override;
+
+    // Queue scene for the next frame. Scenes still waiting are all applied
+    // in order before the next frame, which is rendered once for all of them.
+    void submit(Scene scene);
+
+    // Draw region of the last finished frame
+    void present(QPainter& painter, const QRegion& region);
+
+signals:
+    // A frame finished; region of the front buffer changed
+    void frameReady(const QRegion& region);
+
+protected:
+    void run() override;
+
+private:
+    // Render copies of one shape list, with the position of each key in it
+    template <class Shape>
+    struct List {
+        std::vector<Item<Shape>> items;
+        std::unordered_map<const Shape*, size_t> index;
+    };
+
+    struct Lists {
+        List<Line> lines;
+        List<Circle> circles;
+        List<Polygon> polygons;
+        List<Rectangle> rectangles;
+    };
+
+    // Apply the changes of one scene (or its full lists, on reset), returning
+    // whether anything moved, changed, appeared or disappeared
+    static bool apply(Lists& lists, LayerChanges& changes, bool reset);
+    template <class Shape>
+    static bool apply(List<Shape>& list, Changes<Shape>& changes, bool reset);
+    // Make item hold the copy of next (if it carries one) moved to next's anchor
+    template <class Shape>
+    static bool update(Item<Shape>& item, Item<Shape>& next);
+    // Take over the drawn shapes of next, keeping copies whose version is unchanged
+    static bool sync(Layer& layer, Layer& next);
+    template <class Shape>
+    static bool sync(std::vector<Item<Shape>>& shapes, std::vector<Item<Shape>>& next);
+
+    // Render the scenes (in order) into the back buffer and swap; returns
+    // the changed region
+    QRegion render(std::vector<Scene>& scenes);
+    void drawShapes(Framebuffer& target, const QRect& area, bool skipDragged);
+    void drawDraggedShapes(Framebuffer& target);
+    bool isDragged(const void* key) const;
+    void releaseSprites(const std::vector<const void*>& keys);
+
+    QMutex m_mutex; // guards everything below up to m_front
+    QWaitCondition m_wake;
+    std::vector<Scene> m_pending;
+    bool m_quit = false;
+    Framebuffer m_front; // last finished frame, read by present()
+
+    // Render thread only
+    Framebuffer m_back;
+    Framebuffer m_dragBackground; // every shape except the dragged ones
+    TileRenderer m_tileRenderer;
+    Lists m_shapes; // render copies, kept with their caches between frames
+    Layer m_drawing;
+    std::vector<const void*> m_dragged;
+};
+
+template <class Shape>
+RenderThread::Item<Shape> RenderThread::item(const Shape* shape, quint64& sentVersion)
+{
+    Item<Shape> result{ shape, shape->spriteAnchor(), nullptr };
+    if (sentVersion != shape->spriteVersion()) {
+        result.shape = std::make_unique<Shape>(*shape);
+        sentVersion = shape->spriteVersion();
+    }
+    return result;
+}
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,207 @@
+#include "scaledtexture.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCALEDTEXTURE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SCALEDTEXTURE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace {
+
+// Source sample positions along one axis for target pixels [first, first + count):
+// the sample index and, for bilinear, the 8-bit weight of index + 1
+void buildSamples(int sourceSize, int targetSize, int first, int count, bool bilinear,
+                  std::vector<int>& indices, std::vector<int>& weights)
+{
+    indices.resize(count);
+    weights.resize(count);
+    for (int i = 0; i < count; ++i) {
+        // Center of target pixel t maps to (t + 0.5) * source / target
+        qint64 t = first + i;
+        if (!bilinear) {
+            indices[i] = static_cast<int>(std::min<qint64>((2 * t + 1) * sourceSize / (2 * targetSize), sourceSize - 1));
+            weights[i] = 0;
+            continue;
+        }
+        qint64 position = (2 * t + 1) * sourceSize * 256 / (2 * targetSize) - 128; // minus half a texel
+        position = std::clamp<qint64>(position, 0, static_cast<qint64>(sourceSize - 1) * 256);
+        indices[i] = static_cast<int>(position >> 8);
+        weights[i] = static_cast<int>(position & 0xff);
+    }
+}
+
+// ---- Nearest ----
+
+void nearestRowScalar(QRgb* dst, const QRgb* src, const int* indices, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = src[indices[i]];
+    }
+}
+
+#ifdef SCALEDTEXTURE_AVX2
+__attribute__((target("avx2")))
+void nearestRowAvx2(QRgb* dst, const QRgb* src, const int* indices, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i));
+        __m256i texels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), index, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), texels);
+    }
+    nearestRowScalar(dst + i, src, indices + i, count - i);
+}
+#endif
+
+using NearestRowFunction = void (*)(QRgb*, const QRgb*, const int*, int);
+
+NearestRowFunction selectNearestRow()
+{
+#ifdef SCALEDTEXTURE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return nearestRowAvx2;
+    }
+#endif
+    return nearestRowScalar;
+}
+
+// ---- Bilinear ----
+
+// out = a + (b - a) * weight / 256 per channel, written as
+// (a * (256 - weight) + b * weight) >> 8, which stays within 16 bits
+inline QRgb lerpPixel(QRgb a, QRgb b, uint weight)
+{
+    uint inverse = 256 - weight;
+    uint rb = (((a & 0xff00ff) * inverse + (b & 0xff00ff) * weight) >> 8) & 0xff00ff;
+    uint ag = ((((a >> 8) & 0xff00ff) * inverse + ((b >> 8) & 0xff00ff) * weight) >> 8) & 0xff00ff;
+    return rb | (ag << 8);
+}
+
+// Blend two source rows into one intermediate row (contiguous, so SIMD-friendly)
+void lerpRowsScalar(QRgb* dst, const QRgb* top, const QRgb* bottom, int count, int weight)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = lerpPixel(top[i], bottom[i], weight);
+    }
+}
+
+// Horizontal pass: each target pixel blends two neighbouring intermediate texels
+void lerpColumnsScalar(QRgb* dst, const QRgb* src, const int* indices, const int* weights, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        dst[i] = weights[i] ? lerpPixel(src[indices[i]], src[indices[i] + 1], weights[i]) : src[indices[i]];
+    }
+}
+
+#ifdef SCALEDTEXTURE_SSE2
+void lerpRowsSse2(QRgb* dst, const QRgb* top, const QRgb* bottom, int count, int weight)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w = _mm_set1_epi16(static_cast<short>(weight));
+    const __m128i inverse = _mm_set1_epi16(static_cast<short>(256 - weight));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), inverse),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), inverse),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    lerpRowsScalar(dst + i, top + i, bottom + i, count - i, weight);
+}
+
+void lerpColumnsSse2(QRgb* dst, const QRgb* src, const int* indices, const int* weights, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        // Texel pairs of two target pixels, one pair per 64-bit half
+        __m128i pair0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + indices[i]));
+        __m128i pair1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + indices[i + 1]));
+        __m128i left = _mm_unpacklo_epi32(pair0, pair1);                     // a0 a1
+        __m128i right = _mm_unpacklo_epi32(_mm_srli_si128(pair0, 4), _mm_srli_si128(pair1, 4)); // b0 b1
+        left = _mm_unpacklo_epi8(left, zero);
+        right = _mm_unpacklo_epi8(right, zero);
+
+        __m128i w = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(weights[i])),
+                                       _mm_set1_epi16(static_cast<short>(weights[i + 1])));
+        __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(256), w);
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(left, inverse), _mm_mullo_epi16(right, w));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(_mm_srli_epi16(sum, 8), zero));
+    }
+    lerpColumnsScalar(dst + i, src, indices + i, weights + i, count - i);
+}
+#endif
+
+} // namespace
+
+const QImage& ScaledTexture::scaled(const QImage& source, const QSize& targetSize, const QRect& visible, Filter filter)
+{
+    if (source.cacheKey() != m_sourceKey || m_source.isNull()) {
+        m_sourceKey = source.cacheKey();
+        m_source = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        m_scaled = QImage();
+    }
+    if (m_scaled.isNull() || targetSize != m_targetSize || visible != m_visible || filter != m_filter) {
+        rebuild(targetSize, visible, filter);
+    }
+    return m_scaled;
+}
+
+void ScaledTexture::rebuild(const QSize& targetSize, const QRect& visible, Filter filter)
+{
+    m_targetSize = targetSize;
+    m_visible = visible;
+    m_filter = filter;
+    m_scaled = QImage();
+    if (m_source.isNull() || visible.isEmpty() || targetSize.isEmpty()) return;
+
+    m_scaled = QImage(visible.size(), QImage::Format_ARGB32_Premultiplied);
+    const int sourceWidth = m_source.width();
+    const int sourceHeight = m_source.height();
+    const bool bilinear = filter == Bilinear && sourceWidth > 1 && sourceHeight > 1;
+
+    std::vector<int> xIndices, xWeights, yIndices, yWeights;
+    buildSamples(sourceWidth, targetSize.width(), visible.left(), visible.width(), bilinear, xIndices, xWeights);
+    buildSamples(sourceHeight, targetSize.height(), visible.top(), visible.height(), bilinear, yIndices, yWeights);
+    // The horizontal pass reads index + 1, which must stay inside the row
+    for (int i = 0; bilinear && i < visible.width(); ++i) {
+        if (xIndices[i] == sourceWidth - 1) {
+            xIndices[i] = sourceWidth - 2;
+            xWeights[i] = 256;
+        }
+    }
+
+    auto sourceRow = [this](int y) { return reinterpret_cast<const QRgb*>(m_source.constScanLine(y)); };
+
+    if (!bilinear) {
+        static const NearestRowFunction nearestRow = selectNearestRow();
+        for (int y = 0; y < visible.height(); ++y) {
+            nearestRow(reinterpret_cast<QRgb*>(m_scaled.scanLine(y)), sourceRow(yIndices[y]), xIndices.data(),
+                       visible.width());
+        }
+        return;
+    }
+
+    std::vector<QRgb> intermediate(sourceWidth);
+    for (int y = 0; y < visible.height(); ++y) {
+        const QRgb* top = sourceRow(yIndices[y]);
+        const QRgb* bottom = sourceRow(std::min(yIndices[y] + 1, sourceHeight - 1));
+        QRgb* dst = reinterpret_cast<QRgb*>(m_scaled.scanLine(y));
+#ifdef SCALEDTEXTURE_SSE2
+        lerpRowsSse2(intermediate.data(), top, bottom, sourceWidth, yWeights[y]);
+        lerpColumnsSse2(dst, intermediate.data(), xIndices.data(), xWeights.data(), visible.width());
+#else
+        lerpRowsScalar(intermediate.data(), top, bottom, sourceWidth, yWeights[y]);
+        lerpColumnsScalar(dst, intermediate.data(), xIndices.data(), xWeights.data(), visible.width());
+#endif
+    }
+}
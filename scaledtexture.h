@@ -0,0 +1,35 @@
+#ifndef SCALEDTEXTURE_H
+#define SCALEDTEXTURE_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <vector>
+
+// Fill image resampled once to the size it is drawn at.
+// The texture is rebuilt only when the source image, the target size, the
+// visible part of the target or the filter changes, so repainting an
+// image-filled shape is a plain row copy. Both samplers are vectorized.
+class ScaledTexture {
+public:
+    enum Filter {
+        Nearest,
+        Bilinear
+    };
+
+    // Pixels of source scaled to targetSize, restricted to the visible
+    // sub-rectangle (target coordinates); rows are premultiplied ARGB
+    const QImage& scaled(const QImage& source, const QSize& targetSize, const QRect& visible, Filter filter);
+
+private:
+    void rebuild(const QSize& targetSize, const QRect& visible, Filter filter);
+
+    qint64 m_sourceKey = 0;
+    QImage m_source; // premultiplied copy of the source image
+    QSize m_targetSize;
+    QRect m_visible;
+    Filter m_filter = Nearest;
+    QImage m_scaled;
+};
+
+#endif // SCALEDTEXTURE_H
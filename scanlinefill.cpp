@@ -0,0 +1,256 @@
+#include "scanlinefill.h"
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+
+int ScanlineFill::s_parallelThreshold = 4096;
+
+bool ScanlineFill::lessThan(const Edge& a, const Edge& b)
+{
+    if (a.x != b.x) return a.x < b.x;
+    return static_cast<qint64>(a.num) * b.dy < static_cast<qint64>(b.num) * a.dy;
+}
+
+int ScanlineFill::bandCount()
+{
+    // A few bands per thread so uneven rows still balance out
+    return std::max(1, QThread::idealThreadCount()) * 4;
+}
+
+void ScanlineFill::buildEdges(const QPoint* vertices, int count)
+{
+    m_edges.clear();
+
+    // Horizontal edges never cross a scanline
+    for (int i = 0; i < count; ++i) {
+        QPoint p1 = vertices[i];
+        QPoint p2 = vertices[(i + 1) % count];
+        if (p1.y() == p2.y()) continue;
+        int winding = 1;
+        if (p1.y() > p2.y()) {
+            std::swap(p1, p2);
+            winding = -1;
+        }
+
+        Edge edge;
+        edge.yMin = p1.y();
+        edge.yMax = p2.y();
+        edge.x = p1.x();
+        edge.num = 0;
+        edge.dy = p2.y() - p1.y();
+        int dx = p2.x() - p1.x();
+        edge.stepX = dx / edge.dy;
+        edge.stepNum = dx % edge.dy;
+        if (edge.stepNum < 0) {
+            edge.stepX -= 1;
+            edge.stepNum += edge.dy;
+        }
+        edge.winding = winding;
+        m_edges.push_back(edge);
+    }
+
+    std::sort(m_edges.begin(), m_edges.end(),
+              [](const Edge& a, const Edge& b) { return a.yMin < b.yMin; });
+}
+
+void ScanlineFill::scanRows(const std::vector<Edge>& edges, Qt::FillRule rule, int top, int bottom,
+                            std::vector<Span>& spans)
+{
+    thread_local std::vector<Edge> active;
+    active.clear();
+
+    // Edges already crossing the first row start at their exact position
+    // there: x + (top - yMin) * dx / dy, split into integer and fraction
+    size_t next = 0;
+    for (; next < edges.size() && edges[next].yMin < top; ++next) {
+        Edge edge = edges[next];
+        if (edge.yMax <= top) continue;
+        qint64 rows = top - edge.yMin;
+        qint64 num = rows * edge.stepNum;
+        edge.x += static_cast<int>(rows * edge.stepX + num / edge.dy);
+        edge.num = static_cast<int>(num % edge.dy);
+        active.push_back(edge);
+    }
+    std::sort(active.begin(), active.end(), lessThan);
+
+    for (int y = top; y < bottom && (next < edges.size() || !active.empty()); ++y) {
+        // Activate edges starting here
+        while (next < edges.size() && edges[next].yMin == y) {
+            active.push_back(edges[next++]);
+        }
+
+        // Insertion sort: the table is already ordered except where edges
+        // crossed since the last row and where new edges were appended
+        for (size_t i = 1; i < active.size(); ++i) {
+            Edge edge = active[i];
+            size_t j = i;
+            while (j > 0 && lessThan(edge, active[j - 1])) {
+                active[j] = active[j - 1];
+                --j;
+            }
+            active[j] = edge;
+        }
+
+        // Walk the crossings left to right; the interior runs from the
+        // crossing that enters it to the one that leaves, [ceil(in), floor(out)]
+        int winding = 0;
+        int xStart = 0;
+        for (const Edge& edge : active) {
+            bool wasInside = rule == Qt::OddEvenFill ? (winding & 1) != 0 : winding != 0;
+            winding += rule == Qt::OddEvenFill ? 1 : edge.winding;
+            bool inside = rule == Qt::OddEvenFill ? (winding & 1) != 0 : winding != 0;
+            if (!wasInside && inside) {
+                xStart = edge.x + (edge.num > 0 ? 1 : 0);
+            } else if (wasInside && !inside && edge.x >= xStart) {
+                spans.push_back(Span{y, xStart, edge.x});
+            }
+        }
+
+        // Advance every intersection to the next scanline, retiring edges
+        // that end there (an edge covers yMin <= y < yMax) in the same pass:
+        // survivors are written forward in order and the table truncated once
+        size_t kept = 0;
+        for (size_t i = 0; i < active.size(); ++i) {
+            Edge edge = active[i];
+            if (edge.yMax == y + 1) continue;
+            edge.x += edge.stepX;
+            edge.num += edge.stepNum;
+            if (edge.num >= edge.dy) {
+                edge.x += 1;
+                edge.num -= edge.dy;
+            }
+            active[kept++] = edge;
+        }
+        active.resize(kept);
+    }
+}
+
+void ScanlineFill::rasterize(const QPoint* vertices, int count, Qt::FillRule rule, std::vector<Span>& spans)
+{
+    spans.clear();
+    if (count < 3) return;
+    buildEdges(vertices, count);
+    if (m_edges.empty()) return;
+
+    int top = m_edges.front().yMin;
+    int bottom = top;
+    for (const Edge& edge : m_edges) {
+        bottom = std::max(bottom, edge.yMax);
+    }
+
+    int bands = std::min(bandCount(), bottom - top);
+    if (count < s_parallelThreshold || bands < 2) {
+        scanRows(m_edges, rule, top, bottom, spans);
+        return;
+    }
+
+    // Equal row ranges; each band starts from its own exact edge state
+    m_bands.resize(bands);
+    for (int i = 0; i < bands; ++i) {
+        Band& band = m_bands[i];
+        band.top = top + static_cast<int>(static_cast<qint64>(bottom - top) * i / bands);
+        band.bottom = top + static_cast<int>(static_cast<qint64>(bottom - top) * (i + 1) / bands);
+        band.spans.clear();
+    }
+    const std::vector<Edge>& edges = m_edges;
+    QtConcurrent::blockingMap(m_bands, [&edges, rule](Band& band) {
+        scanRows(edges, rule, band.top, band.bottom, band.spans);
+    });
+
+    // Bands are stitched back in row order
+    for (const Band& band : m_bands) {
+        spans.insert(spans.end(), band.spans.begin(), band.spans.end());
+    }
+}
+
+void ScanlineFill::writeSpans(Framebuffer& fb, const std::vector<Span>& spans,
+                              const std::function<void(const Span&)>& write)
+{
+    // Spans run top to bottom, so only those on rows inside the clip are
+    // visited; a tile of a large polygon skips the rest of its rows
+    const QRect clip = fb.clipRect();
+    size_t begin = std::lower_bound(spans.begin(), spans.end(), clip.top(),
+                                    [](const Span& span, int y) { return span.y < y; }) - spans.begin();
+    size_t end = std::upper_bound(spans.begin() + begin, spans.end(), clip.bottom(),
+                                  [](int y, const Span& span) { return y < span.y; }) - spans.begin();
+    const size_t total = end - begin;
+
+    int bands = std::min<int>(bandCount(), static_cast<int>(total) / 64);
+    if (static_cast<int>(total) < s_parallelThreshold || bands < 2) {
+        for (size_t i = begin; i < end; ++i) {
+            write(spans[i]);
+        }
+        return;
+    }
+
+    // Split the span list into bands that never share a row, so no pixel is
+    // written by two threads and touching spans keep their serial order
+    struct Range {
+        size_t first;
+        size_t last;
+    };
+    std::vector<Range> ranges;
+    size_t first = begin;
+    for (int i = 1; i <= bands && first < end; ++i) {
+        size_t last = begin + total * i / bands;
+        while (last > first && last < end && spans[last].y == spans[last - 1].y) {
+            ++last;
+        }
+        if (last > first) {
+            ranges.push_back(Range{first, last});
+            first = last;
+        }
+    }
+
+    fb.detach();
+    QtConcurrent::blockingMap(ranges, [&spans, &write](Range& range) {
+        for (size_t i = range.first; i < range.last; ++i) {
+            write(spans[i]);
+        }
+    });
+}
+
+void ScanlineFill::fill(Framebuffer& fb, const std::vector<Span>& spans, QRgb color)
+{
+    writeSpans(fb, spans, [&fb, color](const Span& span) { fb.fillSpan(span.x0, span.x1, span.y, color); });
+}
+
+void ScanlineFill::fill(Framebuffer& fb, const std::vector<Span>& spans, const FillShader& shader)
+{
+    if (shader.type() == FillShader::Solid) {
+        fill(fb, spans, shader.color());
+        return;
+    }
+    writeSpans(fb, spans, [&fb, &shader](const Span& span) {
+        const QRect clip = fb.clipRect();
+        if (span.y < clip.top() || span.y > clip.bottom()) return;
+        int x0 = std::max(span.x0, clip.left());
+        int x1 = std::min(span.x1, clip.right());
+        if (x1 < x0) return;
+        thread_local std::vector<QRgb> row;
+        row.resize(x1 - x0 + 1);
+        shader.shade(x0, span.y, x1 - x0 + 1, row.data());
+        fb.blendSpan(x0, span.y, row.data(), x1 - x0 + 1);
+    });
+}
+
+void ScanlineFill::fillTexture(Framebuffer& fb, const std::vector<Span>& spans, const QImage& texture,
+                               const QPoint& origin)
+{
+    if (texture.isNull()) return;
+    const QRect area(origin, texture.size());
+    writeSpans(fb, spans, [&fb, &texture, &area, &origin](const Span& span) {
+        if (span.y < area.top() || span.y > area.bottom()) return;
+        int x0 = std::max(span.x0, area.left());
+        int x1 = std::min(span.x1, area.right());
+        if (x1 < x0) return;
+        const QRgb* row = reinterpret_cast<const QRgb*>(texture.constScanLine(span.y - origin.y()));
+        fb.blendSpan(x0, span.y, row + (x0 - origin.x()), x1 - x0 + 1);
+    });
+}
+
+ScanlineFill& ScanlineFill::scratch()
+{
+    thread_local ScanlineFill filler;
+    return filler;
+}
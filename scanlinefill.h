@@ -0,0 +1,90 @@
+#ifndef SCANLINEFILL_H
+#define SCANLINEFILL_H
+
+#include <QImage>
+#include <QPoint>
+#include <functional>
+#include <vector>
+#include "fillshader.h"
+#include "framebuffer.h"
+
+// Edge-table / active-edge-table polygon filler (even-odd or non-zero rule).
+// Edge intersections are tracked exactly as integer + fraction, the active
+// edge table is kept ordered with an insertion sort (edges only swap where
+// they cross) and the edge and active arrays are reused between calls, so
+// a fill allocates nothing once the arena has grown to the polygon's size.
+//
+// Because every intersection is exact, any row's state can be computed
+// directly from the edge table. Large polygons are therefore split into
+// horizontal bands that are rasterized and filled on the global thread pool;
+// the result is identical to the serial fill whatever the band count.
+class ScanlineFill {
+public:
+    // One interior run [x0, x1] on row y
+    struct Span {
+        int y;
+        int x0;
+        int x1;
+    };
+
+    // Replace spans with the interior of the closed polygon, top to bottom
+    void rasterize(const QPoint* vertices, int count, Qt::FillRule rule, std::vector<Span>& spans);
+
+    // Write previously computed spans to the framebuffer
+    static void fill(Framebuffer& fb, const std::vector<Span>& spans, QRgb color);
+
+    // Write the spans with colors generated per run by the shader
+    static void fill(Framebuffer& fb, const std::vector<Span>& spans, const FillShader& shader);
+
+    // Blend the spans from a premultiplied texture whose top-left pixel sits
+    // at origin; span pixels outside the texture are left untouched
+    static void fillTexture(Framebuffer& fb, const std::vector<Span>& spans, const QImage& texture,
+                            const QPoint& origin);
+
+    // Polygons with at least this many vertices (and span lists with at
+    // least this many spans) are processed in parallel bands
+    static void setParallelThreshold(int threshold) { s_parallelThreshold = threshold; }
+    static int parallelThreshold() { return s_parallelThreshold; }
+
+    // Per-thread scratch filler so fills reuse one arena
+    static ScanlineFill& scratch();
+
+private:
+    // x = x + num / dy exactly, with 0 <= num < dy
+    struct Edge {
+        int yMin;
+        int yMax;
+        int x;
+        int num;
+        int dy;
+        int stepX;   // floor(dx / dy)
+        int stepNum; // dx - stepX * dy
+        int winding; // +1 for edges going down, -1 going up
+    };
+
+    struct Band {
+        int top;    // first row
+        int bottom; // one past the last row
+        std::vector<Span> spans;
+    };
+
+    void buildEdges(const QPoint* vertices, int count);
+
+    // Append the spans of rows [top, bottom) using the sorted edge table
+    static void scanRows(const std::vector<Edge>& edges, Qt::FillRule rule, int top, int bottom,
+                         std::vector<Span>& spans);
+
+    // Call write for every span, in parallel row-disjoint ranges when large
+    static void writeSpans(Framebuffer& fb, const std::vector<Span>& spans,
+                           const std::function<void(const Span&)>& write);
+
+    static bool lessThan(const Edge& a, const Edge& b);
+    static int bandCount();
+
+    static int s_parallelThreshold;
+
+    std::vector<Edge> m_edges; // sorted by yMin
+    std::vector<Band> m_bands;
+};
+
+#endif // SCANLINEFILL_H
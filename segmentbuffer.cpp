@@ -0,0 +1,215 @@
+#include "segmentbuffer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SEGMENTBUFFER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SEGMENTBUFFER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace {
+
+struct Segments {
+    const float* ax;
+    const float* ay;
+    const float* dx;
+    const float* dy;
+    const float* length;
+};
+
+// Squared distance from (px, py), relative to the segment start, to the
+// segment; the projection is clamped to the ends and zero-length segments
+// measure to their start. The vector kernels compute exactly this
+inline float distanceTo(float px, float py, float dx, float dy, float length)
+{
+    float t = length > 0 ? std::min(std::max((px * dx + py * dy) / length, 0.0f), 1.0f) : 0.0f;
+    float ex = px - t * dx;
+    float ey = py - t * dy;
+    return ex * ex + ey * ey;
+}
+
+// Segments [begin, end) one at a time; best/bestDistance carry the running
+// minimum, which only a strictly smaller distance replaces
+void nearestScalar(const Segments& s, float x, float y, int begin, int end, int& best, float& bestDistance)
+{
+    for (int i = begin; i < end; ++i) {
+        float distance = distanceTo(x - s.ax[i], y - s.ay[i], s.dx[i], s.dy[i], s.length[i]);
+        if (distance < bestDistance) {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+}
+
+#ifdef SEGMENTBUFFER_SSE2
+// Four segments per step; selects use and/andnot since blendv is SSE4.1
+void nearestSse2(const Segments& s, float x, float y, int begin, int end, int& best, float& bestDistance)
+{
+    const __m128 px = _mm_set1_ps(x);
+    const __m128 py = _mm_set1_ps(y);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 laneDistance = _mm_set1_ps(bestDistance);
+    __m128i laneIndex = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(begin, begin + 1, begin + 2, begin + 3);
+    const __m128i four = _mm_set1_epi32(4);
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 ex = _mm_sub_ps(px, _mm_loadu_ps(s.ax + i));
+        __m128 ey = _mm_sub_ps(py, _mm_loadu_ps(s.ay + i));
+        __m128 dx = _mm_loadu_ps(s.dx + i);
+        __m128 dy = _mm_loadu_ps(s.dy + i);
+        __m128 length = _mm_loadu_ps(s.length + i);
+
+        __m128 dot = _mm_add_ps(_mm_mul_ps(ex, dx), _mm_mul_ps(ey, dy));
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_div_ps(dot, length), zero), one);
+        t = _mm_and_ps(t, _mm_cmpgt_ps(length, zero));
+        ex = _mm_sub_ps(ex, _mm_mul_ps(t, dx));
+        ey = _mm_sub_ps(ey, _mm_mul_ps(t, dy));
+        __m128 distance = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+
+        __m128 closer = _mm_cmplt_ps(distance, laneDistance);
+        __m128i closerInt = _mm_castps_si128(closer);
+        laneDistance = _mm_or_ps(_mm_and_ps(closer, distance), _mm_andnot_ps(closer, laneDistance));
+        laneIndex = _mm_or_si128(_mm_and_si128(closerInt, index), _mm_andnot_si128(closerInt, laneIndex));
+        index = _mm_add_epi32(index, four);
+    }
+
+    // Each lane kept its first minimum; the lowest index wins between lanes
+    alignas(16) float distances[4];
+    alignas(16) int indices[4];
+    _mm_store_ps(distances, laneDistance);
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), laneIndex);
+    for (int lane = 0; lane < 4; ++lane) {
+        if (indices[lane] < 0) continue;
+        if (distances[lane] < bestDistance || (distances[lane] == bestDistance && indices[lane] < best)) {
+            best = indices[lane];
+            bestDistance = distances[lane];
+        }
+    }
+    nearestScalar(s, x, y, i, end, best, bestDistance);
+}
+#endif
+
+#ifdef SEGMENTBUFFER_AVX2
+__attribute__((target("avx2")))
+void nearestAvx2(const Segments& s, float x, float y, int begin, int end, int& best, float& bestDistance)
+{
+    const __m256 px = _mm256_set1_ps(x);
+    const __m256 py = _mm256_set1_ps(y);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 laneDistance = _mm256_set1_ps(bestDistance);
+    __m256i laneIndex = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(begin), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i eight = _mm256_set1_epi32(8);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 ex = _mm256_sub_ps(px, _mm256_loadu_ps(s.ax + i));
+        __m256 ey = _mm256_sub_ps(py, _mm256_loadu_ps(s.ay + i));
+        __m256 dx = _mm256_loadu_ps(s.dx + i);
+        __m256 dy = _mm256_loadu_ps(s.dy + i);
+        __m256 length = _mm256_loadu_ps(s.length + i);
+
+        __m256 dot = _mm256_add_ps(_mm256_mul_ps(ex, dx), _mm256_mul_ps(ey, dy));
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(dot, length), zero), one);
+        t = _mm256_and_ps(t, _mm256_cmp_ps(length, zero, _CMP_GT_OQ));
+        ex = _mm256_sub_ps(ex, _mm256_mul_ps(t, dx));
+        ey = _mm256_sub_ps(ey, _mm256_mul_ps(t, dy));
+        __m256 distance = _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey));
+
+        __m256 closer = _mm256_cmp_ps(distance, laneDistance, _CMP_LT_OQ);
+        laneDistance = _mm256_blendv_ps(laneDistance, distance, closer);
+        laneIndex = _mm256_blendv_epi8(laneIndex, index, _mm256_castps_si256(closer));
+        index = _mm256_add_epi32(index, eight);
+    }
+
+    // Each lane kept its first minimum; the lowest index wins between lanes
+    alignas(32) float distances[8];
+    alignas(32) int indices[8];
+    _mm256_store_ps(distances, laneDistance);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(indices), laneIndex);
+    for (int lane = 0; lane < 8; ++lane) {
+        if (indices[lane] < 0) continue;
+        if (distances[lane] < bestDistance || (distances[lane] == bestDistance && indices[lane] < best)) {
+            best = indices[lane];
+            bestDistance = distances[lane];
+        }
+    }
+    nearestScalar(s, x, y, i, end, best, bestDistance);
+}
+#endif
+
+using NearestFunction = void (*)(const Segments&, float, float, int, int, int&, float&);
+
+NearestFunction selectNearestFunction()
+{
+#ifdef SEGMENTBUFFER_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return nearestAvx2;
+    }
+#endif
+#ifdef SEGMENTBUFFER_SSE2
+    return nearestSse2;
+#else
+    return nearestScalar;
+#endif
+}
+
+} // namespace
+
+void SegmentBuffer::clear()
+{
+    m_ax.clear();
+    m_ay.clear();
+    m_dx.clear();
+    m_dy.clear();
+    m_length.clear();
+}
+
+void SegmentBuffer::reserve(int count)
+{
+    m_ax.reserve(count);
+    m_ay.reserve(count);
+    m_dx.reserve(count);
+    m_dy.reserve(count);
+    m_length.reserve(count);
+}
+
+void SegmentBuffer::add(const QPoint& a, const QPoint& b)
+{
+    float dx = static_cast<float>(b.x() - a.x());
+    float dy = static_cast<float>(b.y() - a.y());
+    m_ax.push_back(static_cast<float>(a.x()));
+    m_ay.push_back(static_cast<float>(a.y()));
+    m_dx.push_back(dx);
+    m_dy.push_back(dy);
+    m_length.push_back(dx * dx + dy * dy);
+}
+
+int SegmentBuffer::nearest(float x, float y, int begin, int end, float limit, float& distanceSquared) const
+{
+    static const NearestFunction nearestIn = selectNearestFunction();
+
+    // Accepting d <= limit is rejecting d >= the next float up
+    int best = -1;
+    float bestDistance = std::nextafter(limit, HUGE_VALF);
+    const Segments segments{ m_ax.data(), m_ay.data(), m_dx.data(), m_dy.data(), m_length.data() };
+    nearestIn(segments, x, y, begin, end, best, bestDistance);
+    if (best >= 0) distanceSquared = bestDistance;
+    return best;
+}
+
+float SegmentBuffer::distanceSquared(const QPoint& point, const QPoint& a, const QPoint& b)
+{
+    float dx = static_cast<float>(b.x() - a.x());
+    float dy = static_cast<float>(b.y() - a.y());
+    return distanceTo(static_cast<float>(point.x()) - static_cast<float>(a.x()),
+                      static_cast<float>(point.y()) - static_cast<float>(a.y()), dx, dy, dx * dx + dy * dy);
+}
@@ -0,0 +1,37 @@
+#ifndef SEGMENTBUFFER_H
+#define SEGMENTBUFFER_H
+
+#include <QPoint>
+#include <vector>
+
+// Structure-of-arrays list of line segments for batched proximity queries.
+// nearest() measures point-to-segment distances 8 segments at a time with
+// AVX2 (4 with SSE2, one at a time otherwise), picked at runtime. Every path
+// evaluates the same float expression in the same order, so they all return
+// the same segment. Coordinates are relative to an origin of the caller's
+// choosing; integers below 2^24 are exact.
+class SegmentBuffer {
+public:
+    void clear();
+    void reserve(int count);
+    void add(const QPoint& a, const QPoint& b);
+    int size() const { return static_cast<int>(m_ax.size()); }
+
+    // Index of the segment in [begin, end) nearest to (x, y) with a squared
+    // distance of at most limit (the lowest index on ties), or -1;
+    // distanceSquared receives that distance
+    int nearest(float x, float y, int begin, int end, float limit, float& distanceSquared) const;
+
+    // Squared distance from point to the segment [a, b] (a point if a == b),
+    // evaluated exactly as nearest() does
+    static float distanceSquared(const QPoint& point, const QPoint& a, const QPoint& b);
+
+private:
+    std::vector<float> m_ax; // start point
+    std::vector<float> m_ay;
+    std::vector<float> m_dx; // end - start
+    std::vector<float> m_dy;
+    std::vector<float> m_length; // dx^2 + dy^2
+};
+
+#endif // SEGMENTBUFFER_H
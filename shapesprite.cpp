@@ -0,0 +1,67 @@
+#include "shapesprite.h"
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+std::atomic<qint64> totalPixels(0); // held by all sprites, on any thread
+
+} // namespace
+
+quint64 ShapeSprite::firstVersion()
+{
+    static std::atomic<quint64> shapes(0);
+    return ++shapes << 32;
+}
+
+void ShapeSprite::clear()
+{
+    release();
+    m_drawn = false;
+}
+
+bool ShapeSprite::reserve(qint64 pixels)
+{
+    if (pixels > MaxPixels) return false;
+    qint64 total = totalPixels.load();
+    do {
+        if (total + pixels > MaxTotalPixels) return false;
+    } while (!totalPixels.compare_exchange_weak(total, total + pixels));
+    m_reserved = pixels;
+    return true;
+}
+
+void ShapeSprite::release()
+{
+    m_valid = false;
+    if (m_reserved == 0) return;
+    m_image.resize(QSize());
+    totalPixels -= m_reserved;
+    m_reserved = 0;
+}
+
+void ShapeSprite::store(const QRect& bounds, quint64 version, const QPoint& anchor)
+{
+    m_origin = bounds.topLeft();
+    m_anchor = anchor;
+    m_version = version;
+    m_valid = true;
+}
+
+bool ShapeSprite::blit(Framebuffer& fb, quint64 version, const QPoint& anchor) const
+{
+    if (!isCurrent(version)) return false;
+
+    // Source-over every sprite row inside the clip at the translated
+    // position; blendSpan clips horizontally and skips the transparent runs
+    const QPoint topLeft = m_origin + (anchor - m_anchor);
+    const QImage& image = m_image.image();
+    const QRect clip = fb.clipRect();
+    int first = std::max(0, clip.top() - topLeft.y());
+    int last = std::min(image.height(), clip.bottom() + 1 - topLeft.y());
+    for (int row = first; row < last; ++row) {
+        fb.blendSpan(topLeft.x(), topLeft.y() + row, reinterpret_cast<const QRgb*>(image.constScanLine(row)),
+                     image.width());
+    }
+    return true;
+}
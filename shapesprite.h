@@ -0,0 +1,110 @@
+#ifndef SHAPESPRITE_H
+#define SHAPESPRITE_H
+
+#include <QPoint>
+#include <QRect>
+#include <QtGlobal>
+#include "framebuffer.h"
+
+// Rasterized copy of one shape, reused while the shape is only translated.
+// Every shape keeps a version counter that its edits bump (geometry, style,
+// anti-aliasing) but translations do not, plus an anchor point that moves
+// with it. Once a shape is seen at a new anchor with an unchanged version,
+// it is rendered once into a transparent sprite covering boundingRect(), and
+// later frames just composite that sprite at the anchor's offset.
+class ShapeSprite {
+public:
+    // Shapes whose bounds exceed this many pixels are always drawn directly,
+    // as are shapes once all sprites together hold MaxTotalPixels
+    static constexpr qint64 MaxPixels = qint64(1) << 20;
+    static constexpr qint64 MaxTotalPixels = qint64(1) << 22;
+
+    ShapeSprite() = default;
+    // The pixels belong to one shape object: a copied shape starts without them
+    ShapeSprite(const ShapeSprite&) {}
+    ShapeSprite& operator=(const ShapeSprite&)
+    {
+        clear();
+        return *this;
+    }
+    ~ShapeSprite() { release(); }
+
+    // Draw shape (anything exposing spriteVersion(), spriteAnchor(),
+    // boundingRect(), render(Framebuffer&) and translate(QPoint)) into fb
+    template <class Shape>
+    void draw(Framebuffer& fb, Shape& shape)
+    {
+        prepare(shape);
+        paint(fb, shape);
+    }
+
+    // draw() in two steps for tiled rendering: prepare() updates the sprite
+    // once per frame, after which paint() only reads it and can run on
+    // several threads at once, each into its own view of the target
+    template <class Shape>
+    void prepare(Shape& shape);
+    template <class Shape>
+    void paint(Framebuffer& fb, Shape& shape) const
+    {
+        if (!blit(fb, shape.spriteVersion(), shape.spriteAnchor())) shape.render(fb);
+    }
+
+    // Starting version for a new shape. Every shape counts up within a range
+    // of its own, so two shapes never report the same version.
+    static quint64 firstVersion();
+
+    // Whether paint() composites the sprite instead of rendering the shape
+    bool isCurrent(quint64 version) const { return m_valid && version == m_version; }
+
+    // Drop the cached pixels once the shape stops moving (a drag ended); it
+    // is drawn directly again until it is next seen translated
+    void clear();
+
+private:
+    bool blit(Framebuffer& fb, quint64 version, const QPoint& anchor) const;
+    void store(const QRect& bounds, quint64 version, const QPoint& anchor);
+    // Claim pixels from the shared budget, or free this sprite's claim
+    bool reserve(qint64 pixels);
+    void release();
+
+    Framebuffer m_image; // premultiplied, transparent outside the shape
+    QPoint m_origin;     // canvas position of sprite pixel (0, 0) when rendered
+    QPoint m_anchor;     // shape anchor when rendered
+    quint64 m_version = 0;
+    bool m_valid = false;
+    qint64 m_reserved = 0; // pixels claimed from the budget
+
+    // Last directly drawn state, used to notice pure translations
+    QPoint m_drawnAnchor;
+    quint64 m_drawnVersion = 0;
+    bool m_drawn = false;
+};
+
+template <class Shape>
+void ShapeSprite::prepare(Shape& shape)
+{
+    const quint64 version = shape.spriteVersion();
+    const QPoint anchor = shape.spriteAnchor();
+    if (isCurrent(version)) return;
+
+    // Only a shape that moved without changing is worth a sprite; anything
+    // edited (e.g. a vertex being dragged) keeps drawing directly, and stale
+    // pixels are freed either way
+    bool translated = m_drawn && version == m_drawnVersion && anchor != m_drawnAnchor;
+    release();
+    m_drawn = true;
+    m_drawnVersion = version;
+    m_drawnAnchor = anchor;
+    if (!translated) return;
+
+    QRect bounds = shape.boundingRect();
+    if (bounds.isEmpty() || !reserve(static_cast<qint64>(bounds.width()) * bounds.height())) return;
+    m_image.resize(bounds.size());
+    m_image.clear(Qt::transparent);
+    shape.translate(-bounds.topLeft());
+    shape.render(m_image);
+    shape.translate(bounds.topLeft());
+    store(bounds, version, anchor);
+}
+
+#endif // SHAPESPRITE_H
@@ -0,0 +1,120 @@
+#include "spatialgrid.h"
+#include <algorithm>
+
+bool SpatialGrid::isLarge(const QRect& bounds)
+{
+    qint64 columns = cell(bounds.right()) - cell(bounds.left()) + 1;
+    qint64 rows = cell(bounds.bottom()) - cell(bounds.top()) + 1;
+    return columns * rows > MaxCells;
+}
+
+void SpatialGrid::link(const Slot& slot)
+{
+    if (isLarge(slot.bounds)) {
+        m_large.push_back(slot);
+        return;
+    }
+    for (int row = cell(slot.bounds.top()); row <= cell(slot.bounds.bottom()); ++row) {
+        for (int column = cell(slot.bounds.left()); column <= cell(slot.bounds.right()); ++column) {
+            m_cells[cellKey(column, row)].push_back(slot);
+        }
+    }
+}
+
+void SpatialGrid::unlink(void* item, const QRect& bounds)
+{
+    // Queries sort by insertion order, so slots are swap-removed
+    auto erase = [item](std::vector<Slot>& entries) {
+        auto found = std::find_if(entries.begin(), entries.end(), [item](const Slot& slot) { return slot.item == item; });
+        if (found != entries.end()) {
+            *found = entries.back();
+            entries.pop_back();
+        }
+    };
+    if (isLarge(bounds)) {
+        erase(m_large);
+        return;
+    }
+    for (int row = cell(bounds.top()); row <= cell(bounds.bottom()); ++row) {
+        for (int column = cell(bounds.left()); column <= cell(bounds.right()); ++column) {
+            auto bucket = m_cells.find(cellKey(column, row));
+            if (bucket == m_cells.end()) continue;
+            erase(bucket->second);
+            if (bucket->second.empty()) m_cells.erase(bucket);
+        }
+    }
+}
+
+void SpatialGrid::insert(void* item, const QRect& bounds)
+{
+    Slot slot{ item, m_nextOrder++, bounds.normalized() };
+    m_items[item] = slot;
+    if (!slot.bounds.isEmpty()) link(slot);
+}
+
+void SpatialGrid::update(void* item, const QRect& bounds)
+{
+    auto found = m_items.find(item);
+    if (found == m_items.end()) return;
+
+    Slot& slot = found->second;
+    QRect normalized = bounds.normalized();
+    if (normalized == slot.bounds) return;
+    if (!slot.bounds.isEmpty()) unlink(item, slot.bounds);
+    slot.bounds = normalized;
+    if (!slot.bounds.isEmpty()) link(slot);
+}
+
+void SpatialGrid::remove(void* item)
+{
+    auto found = m_items.find(item);
+    if (found == m_items.end()) return;
+    if (!found->second.bounds.isEmpty()) unlink(item, found->second.bounds);
+    m_items.erase(found);
+}
+
+void SpatialGrid::clear()
+{
+    m_items.clear();
+    m_cells.clear();
+    m_large.clear();
+}
+
+std::vector<void*> SpatialGrid::query(const QRect& area) const
+{
+    std::vector<const Slot*> hits;
+    if (area.isEmpty()) return {};
+    auto collect = [&hits, &area](const std::vector<Slot>& entries) {
+        for (const Slot& slot : entries) {
+            if (slot.bounds.intersects(area)) hits.push_back(&slot);
+        }
+    };
+
+    qint64 columns = cell(area.right()) - cell(area.left()) + 1;
+    qint64 rows = cell(area.bottom()) - cell(area.top()) + 1;
+    if (columns * rows > static_cast<qint64>(m_items.size())) {
+        // Fewer items than cells to look up: test each item once
+        for (const auto& item : m_items) {
+            if (item.second.bounds.intersects(area)) hits.push_back(&item.second);
+        }
+    } else {
+        for (int row = cell(area.top()); row <= cell(area.bottom()); ++row) {
+            for (int column = cell(area.left()); column <= cell(area.right()); ++column) {
+                auto bucket = m_cells.find(cellKey(column, row));
+                if (bucket != m_cells.end()) collect(bucket->second);
+            }
+        }
+        collect(m_large);
+    }
+
+    // An item overlapping several of the cells was collected from each
+    std::sort(hits.begin(), hits.end(), [](const Slot* a, const Slot* b) { return a->order < b->order; });
+    hits.erase(std::unique(hits.begin(), hits.end(), [](const Slot* a, const Slot* b) { return a->order == b->order; }),
+               hits.end());
+    std::vector<void*> items;
+    items.reserve(hits.size());
+    for (const Slot* slot : hits) {
+        items.push_back(slot->item);
+    }
+    return items;
+}
@@ -0,0 +1,78 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QRect>
+#include <QtGlobal>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid over the hit bounds of shapes, for area queries.
+// Each item is listed in every 64 px cell its bounds overlap (cells are
+// hashed, so the canvas has no fixed extent); items spanning more than
+// MaxCells cells go to a single list that every query scans instead. A
+// query only tests the items of the cells it covers, whatever the document
+// size.
+class SpatialGrid {
+public:
+    static constexpr int CellShift = 6; // 64 px cells
+    static constexpr int MaxCells = 256;
+
+    void insert(void* item, const QRect& bounds);
+    // Items that were never inserted (e.g. a shape still being drawn) are ignored
+    void update(void* item, const QRect& bounds);
+    void remove(void* item);
+    void clear();
+
+    // Items whose bounds intersect area, in insertion order
+    std::vector<void*> query(const QRect& area) const;
+
+private:
+    struct Slot {
+        void* item;
+        quint64 order; // insertion sequence number
+        QRect bounds;
+    };
+
+    // Grid cell containing coordinate v (an arithmetic shift floors negatives too)
+    static int cell(int v) { return v >> CellShift; }
+    static quint64 cellKey(int column, int row)
+    {
+        return (static_cast<quint64>(static_cast<quint32>(column)) << 32) | static_cast<quint32>(row);
+    }
+    static bool isLarge(const QRect& bounds);
+
+    void link(const Slot& slot);
+    void unlink(void* item, const QRect& bounds);
+
+    std::unordered_map<void*, Slot> m_items;
+    std::unordered_map<quint64, std::vector<Slot>> m_cells;
+    std::vector<Slot> m_large;
+    quint64 m_nextOrder = 0;
+};
+
+// SpatialGrid holding one shape type; Shape provides hitBounds()
+template <class Shape>
+class ShapeIndex {
+public:
+    void insert(Shape* shape) { m_grid.insert(shape, shape->hitBounds()); }
+    void update(Shape* shape) { m_grid.update(shape, shape->hitBounds()); }
+    void remove(Shape* shape) { m_grid.remove(shape); }
+    void clear() { m_grid.clear(); }
+
+    // Shapes that may draw into area, in the order they were inserted
+    std::vector<Shape*> overlapping(const QRect& area) const
+    {
+        std::vector<void*> items = m_grid.query(area);
+        std::vector<Shape*> shapes;
+        shapes.reserve(items.size());
+        for (void* item : items) {
+            shapes.push_back(static_cast<Shape*>(item));
+        }
+        return shapes;
+    }
+
+private:
+    SpatialGrid m_grid;
+};
+
+#endif // SPATIALGRID_H
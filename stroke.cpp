@@ -0,0 +1,80 @@
+#include "stroke.h"
+#include "capsule.h"
+#include "coveragemask.h"
+#include "linekernel.h"
+#include "strokemask.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+QRect pointBounds(const QPoint* points, int count)
+{
+    int minX = points[0].x();
+    int maxX = minX;
+    int minY = points[0].y();
+    int maxY = minY;
+    for (int i = 1; i < count; ++i) {
+        minX = std::min(minX, points[i].x());
+        maxX = std::max(maxX, points[i].x());
+        minY = std::min(minY, points[i].y());
+        maxY = std::max(maxY, points[i].y());
+    }
+    return QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+}
+
+template <class BrushClass>
+void strokeAliased(Framebuffer& fb, const QPoint* points, int count, bool closed,
+                   const Brush& brush, QRgb color)
+{
+    // All edges share one coverage mask so joints are written once
+    StrokeMask& mask = StrokeMask::scratch();
+    mask.reset(pointBounds(points, count), brush, fb.clipRect());
+    if (mask.isEmpty()) return;
+
+    // Long polylines go through the SIMD batch stepper; the mask is an
+    // order-independent sink, so batching does not change the output
+    LineKernel::MaskSink<BrushClass> sink{mask, brush};
+    if (count > LineBatch::Lanes) {
+        LineKernel::drawPolylineBatched(points, count, closed, mask.stampArea(brush), sink);
+    } else {
+        LineKernel::drawPolyline<LineKernel::Aliased>(points, count, closed, sink);
+    }
+    mask.composite(fb, color);
+}
+
+} // namespace
+
+void strokePolyline(Framebuffer& fb, const QPoint* points, int count, bool closed,
+                    const Brush& brush, bool antiAliasing, QRgb color)
+{
+    if (count < 2) return;
+
+    if (!antiAliasing) {
+        if (brush.getSize() == 1) {
+            strokeAliased<LineKernel::OnePixelBrush>(fb, points, count, closed, brush, color);
+        } else {
+            strokeAliased<LineKernel::DiscBrush>(fb, points, count, closed, brush, color);
+        }
+        return;
+    }
+
+    // Anti-aliased edges record coverage first (overlaps keep the maximum,
+    // so joints are not blended twice) and are blended in one vectorized pass
+    float radius = brush.getSize() / 2.0f;
+    int margin = static_cast<int>(std::ceil(radius)) + 1;
+    CoverageMask& mask = CoverageMask::scratch();
+    mask.reset(pointBounds(points, count).adjusted(-margin, -margin, margin, margin), fb.clipRect());
+    if (mask.isEmpty()) return;
+
+    if (brush.getSize() > 1) {
+        int edges = closed ? count : count - 1;
+        for (int i = 0; i < edges; ++i) {
+            drawCapsule(mask, points[i], points[(i + 1) % count], radius);
+        }
+    } else {
+        LineKernel::CoverageSink sink{mask};
+        LineKernel::drawPolyline<LineKernel::AntiAliased>(points, count, closed, sink);
+    }
+    mask.composite(fb, color);
+}
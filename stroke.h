@@ -0,0 +1,14 @@
+#ifndef STROKE_H
+#define STROKE_H
+
+#include <QPoint>
+#include "brush.h"
+#include "framebuffer.h"
+
+// Draw the edges of a polyline with a brush.
+// Picks the specialized line kernel for the brush size and anti-aliasing
+// mode; this is the single stroking path used by Line, Polygon and Rectangle.
+void strokePolyline(Framebuffer& fb, const QPoint* points, int count, bool closed,
+                    const Brush& brush, bool antiAliasing, QRgb color);
+
+#endif // STROKE_H
@@ -0,0 +1,102 @@
+#include "strokemask.h"
+#include <QtAlgorithms>
+#include <algorithm>
+
+void StrokeMask::reset(const QRect& pointBounds, const Brush& brush, const QRect& clip)
+{
+    int halfSize = brush.getSize() / 2;
+    int extent = brush.getSize() - 1 - halfSize;
+    m_bounds = pointBounds.adjusted(-halfSize, -halfSize, extent, extent).intersected(clip);
+    if (m_bounds.isEmpty()) {
+        m_wordsPerRow = 0;
+        return;
+    }
+
+    m_wordsPerRow = (m_bounds.width() + 63) / 64;
+    m_words.assign(static_cast<size_t>(m_wordsPerRow) * m_bounds.height(), 0);
+}
+
+QRect StrokeMask::stampArea(const Brush& brush) const
+{
+    // A stamp centered on x covers [x - halfSize, x + extent]
+    int halfSize = brush.getSize() / 2;
+    int extent = brush.getSize() - 1 - halfSize;
+    return m_bounds.adjusted(-extent, -extent, halfSize, halfSize);
+}
+
+void StrokeMask::stamp(const Brush& brush, int x, int y)
+{
+    int halfSize = brush.getSize() / 2;
+    int left = x - halfSize;
+    int top = y - halfSize;
+    const Brush::Span* spans = brush.getSpans();
+
+    for (int r = 0; r < brush.getSize(); ++r) {
+        const Brush::Span& span = spans[r];
+        if (span.length > 0) {
+            setSpan(left + span.start, left + span.start + span.length - 1, top + r);
+        }
+    }
+}
+
+void StrokeMask::setSpan(int x0, int x1, int y)
+{
+    if (y < m_bounds.top() || y > m_bounds.bottom()) return;
+    x0 = std::max(x0, m_bounds.left()) - m_bounds.left();
+    x1 = std::min(x1, m_bounds.right()) - m_bounds.left();
+    if (x1 < x0) return;
+
+    uint64_t* words = row(y - m_bounds.top());
+    int firstWord = x0 >> 6;
+    int lastWord = x1 >> 6;
+    uint64_t firstMask = ~uint64_t(0) << (x0 & 63);
+    uint64_t lastMask = ~uint64_t(0) >> (63 - (x1 & 63));
+
+    if (firstWord == lastWord) {
+        words[firstWord] |= firstMask & lastMask;
+        return;
+    }
+    words[firstWord] |= firstMask;
+    for (int w = firstWord + 1; w < lastWord; ++w) {
+        words[w] = ~uint64_t(0);
+    }
+    words[lastWord] |= lastMask;
+}
+
+void StrokeMask::composite(Framebuffer& fb, QRgb color) const
+{
+    int width = m_bounds.width();
+
+    for (int y = 0; y < m_bounds.height(); ++y) {
+        const uint64_t* words = row(y);
+        int x = 0;
+        while (x < width) {
+            // Find the next set bit at or after x
+            int w = x >> 6;
+            uint64_t bits = words[w] & (~uint64_t(0) << (x & 63));
+            while (bits == 0 && ++w < m_wordsPerRow) {
+                bits = words[w];
+            }
+            if (bits == 0) break;
+            int start = (w << 6) + qCountTrailingZeroBits(bits);
+
+            // Find the next clear bit after start (bits past width are never set)
+            w = start >> 6;
+            bits = ~words[w] & (~uint64_t(0) << (start & 63));
+            while (bits == 0 && ++w < m_wordsPerRow) {
+                bits = ~words[w];
+            }
+            int end = bits == 0 ? m_wordsPerRow << 6 : (w << 6) + qCountTrailingZeroBits(bits);
+            end = std::min(end, width);
+
+            fb.fillSpan(m_bounds.left() + start, m_bounds.left() + end - 1, m_bounds.top() + y, color);
+            x = end;
+        }
+    }
+}
+
+StrokeMask& StrokeMask::scratch()
+{
+    thread_local StrokeMask mask;
+    return mask;
+}
@@ -0,0 +1,45 @@
+#ifndef STROKEMASK_H
+#define STROKEMASK_H
+
+#include <QRect>
+#include <cstdint>
+#include <vector>
+#include "brush.h"
+#include "framebuffer.h"
+
+// 1-bit coverage mask for thick strokes.
+// Brush stamps are ORed into 64-bit words over the stroke's bounding box, so
+// overlapping stamps along a DDA path cost nothing extra; the covered pixels
+// are then composited to the framebuffer exactly once as horizontal runs.
+class StrokeMask {
+public:
+    // Clear the mask to cover every brush stamp centered inside pointBounds,
+    // clipped to clip (usually the framebuffer rect)
+    void reset(const QRect& pointBounds, const Brush& brush, const QRect& clip);
+    bool isEmpty() const { return m_bounds.isEmpty(); }
+
+    // Centers of the brush stamps that reach the mask
+    QRect stampArea(const Brush& brush) const;
+
+    // OR the brush rows centered on (x, y) into the mask
+    void stamp(const Brush& brush, int x, int y);
+
+    // OR the inclusive run [x0, x1] on row y (framebuffer coordinates)
+    void setSpan(int x0, int x1, int y);
+
+    // Write every covered run to the framebuffer once
+    void composite(Framebuffer& fb, QRgb color) const;
+
+    // Per-thread scratch mask so strokes reuse one allocation
+    static StrokeMask& scratch();
+
+private:
+    const uint64_t* row(int y) const { return m_words.data() + static_cast<size_t>(y) * m_wordsPerRow; }
+    uint64_t* row(int y) { return m_words.data() + static_cast<size_t>(y) * m_wordsPerRow; }
+
+    QRect m_bounds;
+    int m_wordsPerRow = 0;
+    std::vector<uint64_t> m_words;
+};
+
+#endif // STROKEMASK_H
@@ -0,0 +1,81 @@
+#include "tilerenderer.h"
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+
+void TileRenderer::begin(Framebuffer& target, const QRect& area)
+{
+    m_target = &target;
+    m_area = area.intersected(target.image().rect());
+    for (Tile& tile : m_tiles) {
+        tile.commands.clear();
+    }
+    if (m_area.isEmpty()) {
+        m_columns = m_rows = 0;
+        return;
+    }
+
+    // Cells are aligned to the canvas, not the area, so a shape lands in
+    // the same tiles whichever part of the canvas is being repainted
+    m_firstCell = QPoint(cell(m_area.left()), cell(m_area.top()));
+    m_columns = cell(m_area.right()) - m_firstCell.x() + 1;
+    m_rows = cell(m_area.bottom()) - m_firstCell.y() + 1;
+    if (static_cast<int>(m_tiles.size()) < m_columns * m_rows) {
+        m_tiles.resize(m_columns * m_rows);
+    }
+    for (int row = 0; row < m_rows; ++row) {
+        for (int column = 0; column < m_columns; ++column) {
+            QRect rect((m_firstCell.x() + column) * TileSize, (m_firstCell.y() + row) * TileSize, TileSize,
+                       TileSize);
+            m_tiles[row * m_columns + column].rect = rect.intersected(m_area);
+        }
+    }
+}
+
+void TileRenderer::bin(const QRect& bounds, const Command& command)
+{
+    QRect clipped = bounds.intersected(m_area);
+    int left = cell(clipped.left()) - m_firstCell.x();
+    int right = cell(clipped.right()) - m_firstCell.x();
+    int top = cell(clipped.top()) - m_firstCell.y();
+    int bottom = cell(clipped.bottom()) - m_firstCell.y();
+    for (int row = top; row <= bottom; ++row) {
+        for (int column = left; column <= right; ++column) {
+            m_tiles[row * m_columns + column].commands.push_back(command);
+        }
+    }
+}
+
+void TileRenderer::render(QRgb background)
+{
+    const int count = m_columns * m_rows;
+    int workers = std::min(QThread::idealThreadCount(), count);
+    if (workers < 2) {
+        for (int i = 0; i < count; ++i) {
+            renderTile(m_tiles[i], background);
+        }
+    } else {
+        // One job per worker, each pulling tiles off a shared counter until
+        // none are left, so a few expensive tiles do not stall the rest
+        m_target->detach();
+        std::atomic<int> next(0);
+        std::vector<int> jobs(workers);
+        QtConcurrent::blockingMap(jobs, [this, &next, count, background](int&) {
+            for (int i = next++; i < count; i = next++) {
+                renderTile(m_tiles[i], background);
+            }
+        });
+    }
+    m_columns = m_rows = 0;
+}
+
+void TileRenderer::renderTile(Tile& tile, QRgb background)
+{
+    Framebuffer view = m_target->view();
+    view.setClipRect(tile.rect);
+    view.fillRect(tile.rect, background);
+    for (const Command& command : tile.commands) {
+        command.paint(command.shape, view);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <QRect>
+#include <QtGlobal>
+#include <vector>
+#include "framebuffer.h"
+
+// Parallel repaint of one area of the canvas.
+// Shapes are added in stacking order and binned by bounding box into fixed
+// screen tiles, each with its own display list. render() then clears and
+// replays the tiles on the global thread pool: idle workers keep taking the
+// next unrendered tile, each drawing through a view of the target clipped to
+// that tile, so no pixel is written by two threads and every tile keeps the
+// serial stacking order.
+//
+// Shapes must provide prepareDraw(const Framebuffer&), called once here on
+// the adding thread, and paint(Framebuffer&), which is then safe to call
+// from several threads at once.
+class TileRenderer {
+public:
+    static constexpr int TileSize = 128;
+
+    // Start a display list covering area of target (clipped to the image)
+    void begin(Framebuffer& target, const QRect& area);
+
+    // Queue shape for every tile its bounding box overlaps
+    template <class Shape>
+    void add(Shape* shape);
+
+    // Fill each tile with background and replay its display list
+    void render(QRgb background);
+
+private:
+    struct Command {
+        void* shape;
+        void (*paint)(void* shape, Framebuffer& fb);
+    };
+
+    struct Tile {
+        QRect rect; // grid cell cut to the area
+        std::vector<Command> commands;
+    };
+
+    template <class Shape>
+    static void paintShape(void* shape, Framebuffer& fb)
+    {
+        static_cast<Shape*>(shape)->paint(fb);
+    }
+
+    static int cell(int v) { return v / TileSize; } // v is never negative
+    void bin(const QRect& bounds, const Command& command);
+    void renderTile(Tile& tile, QRgb background);
+
+    Framebuffer* m_target = nullptr;
+    QRect m_area;
+    QPoint m_firstCell; // grid coordinates of the top-left tile
+    int m_columns = 0;
+    int m_rows = 0;
+    std::vector<Tile> m_tiles; // row-major; command lists keep their capacity
+};
+
+template <class Shape>
+void TileRenderer::add(Shape* shape)
+{
+    QRect bounds = shape->boundingRect();
+    if (!bounds.intersects(m_area)) return;
+    shape->prepareDraw(*m_target);
+    bin(bounds, Command{shape, &paintShape<Shape>});
+}
+
+#endif // TILERENDERER_H
@@ -0,0 +1,107 @@
+#include "vertexgrid.h"
+#include <algorithm>
+#include <utility>
+
+void VertexGrid::link(const void* shape, int index, const QPoint& point)
+{
+    m_cells[cellKey(point)].push_back(Entry{ point, shape, index });
+}
+
+void VertexGrid::unlink(const void* shape, int index, const QPoint& point)
+{
+    auto bucket = m_cells.find(cellKey(point));
+    if (bucket == m_cells.end()) return;
+    std::vector<Entry>& entries = bucket->second;
+    auto found = std::find_if(entries.begin(), entries.end(),
+                              [shape, index](const Entry& entry) { return entry.shape == shape && entry.index == index; });
+    if (found != entries.end()) {
+        *found = entries.back();
+        entries.pop_back();
+    }
+    if (entries.empty()) m_cells.erase(bucket);
+}
+
+void VertexGrid::insert(const void* shape, const std::vector<QPoint>& vertices)
+{
+    remove(shape);
+    for (int i = 0; i < static_cast<int>(vertices.size()); ++i) {
+        link(shape, i, vertices[i]);
+    }
+    m_shapes[shape] = vertices;
+}
+
+void VertexGrid::update(const void* shape, const std::vector<QPoint>& vertices)
+{
+    auto found = m_shapes.find(shape);
+    if (found == m_shapes.end()) return;
+
+    std::vector<QPoint>& listed = found->second;
+    const int common = static_cast<int>(std::min(listed.size(), vertices.size()));
+    for (int i = 0; i < common; ++i) {
+        if (listed[i] == vertices[i]) continue;
+        if (cellKey(listed[i]) == cellKey(vertices[i])) {
+            // Same cell: rewrite the entry in place
+            for (Entry& entry : m_cells[cellKey(listed[i])]) {
+                if (entry.shape == shape && entry.index == i) {
+                    entry.point = vertices[i];
+                    break;
+                }
+            }
+        } else {
+            unlink(shape, i, listed[i]);
+            link(shape, i, vertices[i]);
+        }
+        listed[i] = vertices[i];
+    }
+    for (int i = common; i < static_cast<int>(listed.size()); ++i) {
+        unlink(shape, i, listed[i]);
+    }
+    for (int i = common; i < static_cast<int>(vertices.size()); ++i) {
+        link(shape, i, vertices[i]);
+    }
+    listed.resize(vertices.size());
+    std::copy(vertices.begin() + common, vertices.end(), listed.begin() + common);
+}
+
+void VertexGrid::remove(const void* shape)
+{
+    auto found = m_shapes.find(shape);
+    if (found == m_shapes.end()) return;
+    for (int i = 0; i < static_cast<int>(found->second.size()); ++i) {
+        unlink(shape, i, found->second[i]);
+    }
+    m_shapes.erase(found);
+}
+
+void VertexGrid::clear()
+{
+    m_shapes.clear();
+    m_cells.clear();
+}
+
+bool VertexGrid::nearest(const QPoint& point, int radius, const void* exclude, QPoint& vertex) const
+{
+    bool found = false;
+    qint64 bestDistance = static_cast<qint64>(radius) * radius;
+    for (int row = cell(point.y() - radius); row <= cell(point.y() + radius); ++row) {
+        for (int column = cell(point.x() - radius); column <= cell(point.x() + radius); ++column) {
+            auto bucket = m_cells.find(cellKey(column, row));
+            if (bucket == m_cells.end()) continue;
+            for (const Entry& entry : bucket->second) {
+                if (entry.shape == exclude) continue;
+                const qint64 dx = entry.point.x() - point.x();
+                const qint64 dy = entry.point.y() - point.y();
+                const qint64 distance = dx * dx + dy * dy;
+                if (distance > bestDistance) continue;
+                if (found && distance == bestDistance &&
+                    std::make_pair(entry.point.y(), entry.point.x()) >= std::make_pair(vertex.y(), vertex.x())) {
+                    continue;
+                }
+                vertex = entry.point;
+                bestDistance = distance;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,52 @@
+#ifndef VERTEXGRID_H
+#define VERTEXGRID_H
+
+#include <QPoint>
+#include <QtGlobal>
+#include <unordered_map>
+#include <vector>
+
+// Hashed uniform grid over the vertices of shapes, for snapping.
+// Each vertex is listed in the 16 px cell containing it, so the nearest
+// vertex within a snap radius is found in the few cells around the point,
+// however many vertices there are. update() compares a shape's vertices
+// with the ones it listed last time and only moves those that changed, so
+// dragging one vertex of a large polygon re-lists one vertex.
+class VertexGrid {
+public:
+    static constexpr int CellShift = 4; // 16 px cells
+
+    void insert(const void* shape, const std::vector<QPoint>& vertices);
+    // Shapes that were never inserted (e.g. one still being drawn) are ignored
+    void update(const void* shape, const std::vector<QPoint>& vertices);
+    void remove(const void* shape);
+    void clear();
+    bool contains(const void* shape) const { return m_shapes.count(shape) != 0; }
+
+    // Vertex nearest to point within radius, of any shape but exclude (ties
+    // go to the smaller y, then x); false if there is none
+    bool nearest(const QPoint& point, int radius, const void* exclude, QPoint& vertex) const;
+
+private:
+    struct Entry {
+        QPoint point;
+        const void* shape;
+        int index; // in the shape's vertex list
+    };
+
+    // Grid cell containing coordinate v (an arithmetic shift floors negatives too)
+    static int cell(int v) { return v >> CellShift; }
+    static quint64 cellKey(int column, int row)
+    {
+        return (static_cast<quint64>(static_cast<quint32>(column)) << 32) | static_cast<quint32>(row);
+    }
+    static quint64 cellKey(const QPoint& point) { return cellKey(cell(point.x()), cell(point.y())); }
+
+    void link(const void* shape, int index, const QPoint& point);
+    void unlink(const void* shape, int index, const QPoint& point);
+
+    std::unordered_map<const void*, std::vector<QPoint>> m_shapes; // vertices as listed
+    std::unordered_map<quint64, std::vector<Entry>> m_cells;
+};
+
+#endif // VERTEXGRID_H